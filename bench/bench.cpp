@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// treeburner_bench : times the simulation and lighting kernels on synthetic maps,
+// without window nor UI. run it from the game directory (it needs data/cfg).
+// usage : treeburner_bench [iterations]
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "base/gameengine.hpp"
+#include "main.hpp"
+#include "map/dungeon.hpp"
+#include "map/light.hpp"
+#include "map/lightmap.hpp"
+#include "util/cellular.hpp"
+#include "util/clouds.hpp"
+#include "util/fire.hpp"
+#include "util/powerup.hpp"
+#include "util/ripples.hpp"
+#include "util/textgen.hpp"
+#include "util/worldgen.hpp"
+
+// a game engine that never renders. provides gameEngine->dungeon and the viewport to the kernels
+class BenchEngine : public base::GameEngine {
+ public:
+  BenchEngine() { headless = true; }
+  void render() override {}
+  void setDungeon(map::Dungeon* d) {
+    dungeon = d;
+    // center the viewport on the map
+    xOffset = std::max(0, d->width / 2 - CON_W / 2);
+    yOffset = std::max(0, d->height / 2 - CON_H / 2);
+    player.setPos(xOffset + CON_W / 2, yOffset + CON_H / 2);
+  }
+  util::FireManager* getFireManager() { return fireManager; }
+  util::RippleManager* getRippleManager() { return rippleManager; }
+  void createManagers() {
+    delete fireManager;
+    delete rippleManager;
+    fireManager = new util::FireManager(dungeon);
+    rippleManager = new util::RippleManager(dungeon);
+  }
+};
+
+static int iterations = 50;
+
+// run func iterations times and print one line per kernel
+static void bench(const char* name, int size, int nbIter, std::function<void()> func) {
+  std::vector<double> times;
+  times.reserve(nbIter);
+  for (int i = 0; i < nbIter; i++) {
+    auto t0 = std::chrono::steady_clock::now();
+    func();
+    times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+  }
+  std::sort(times.begin(), times.end());
+  double total = 0.0;
+  for (double t : times) total += t;
+  printf("%-28s %5d %6d %10.3f %10.3f %10.3f\n", name, size, nbIter, total / nbIter, times[0], times[nbIter / 2]);
+}
+
+// an outdoor map with random rocks and a lake in the middle
+static map::Dungeon* buildDungeon(int size) {
+  TCODRandom rnd(size);
+  map::Dungeon* dungeon = new map::Dungeon(size, size);
+  for (int x = 1; x < size - 1; x++) {
+    for (int y = 1; y < size - 1; y++) {
+      bool rock = rnd.getInt(0, 100) < 8;
+      dungeon->setProperties(x, y, !rock, !rock);
+      dungeon->setTerrainType(x, y, map::TERRAIN_GRASS_NORMAL);
+    }
+  }
+  int lakex = size / 2 - 8;
+  int lakey = size / 2 + 4;
+  for (int x = lakex; x < lakex + 16; x++) {
+    for (int y = lakey; y < lakey + 12; y++) {
+      dungeon->setTerrainType(x, y, map::TERRAIN_SHALLOW_WATER);
+      for (int sx = 0; sx < 2; sx++) {
+        for (int sy = 0; sy < 2; sy++) dungeon->getSubCell(x * 2 + sx, y * 2 + sy)->waterCoef = 0.5f;
+      }
+    }
+  }
+  for (int x = 0; x < size * 2; x++) {
+    for (int y = 0; y < size * 2; y++) {
+      dungeon->setGroundColor(x, y, TCODColor::lerp(TCODColor::darkGreen, TCODColor::darkerOrange, rnd.getFloat(0.0f, 1.0f)));
+    }
+  }
+  dungeon->setAmbient(TCODColor::darkGrey);
+  return dungeon;
+}
+
+static void benchMapSize(BenchEngine& game, int size) {
+  map::Dungeon* dungeon = buildDungeon(size);
+  game.setDungeon(dungeon);
+  game.createManagers();
+  dungeon->computeFov((int)game.player.x_, (int)game.player.y_);
+
+  // lights spread over the viewport
+  TCODRandom rnd(size);
+  std::vector<map::Light*> lights;
+  for (int i = 0; i < 32; i++) {
+    map::Light* light = new map::Light(rnd.getFloat(4.0f, 20.0f), TCODColor::lightFlame, i % 2 == 0);
+    light->setPos(
+        (float)(game.xOffset * 2 + rnd.getInt(0, CON_W * 2 - 1)), (float)(game.yOffset * 2 + rnd.getInt(0, CON_H * 2 - 1)));
+    lights.push_back(light);
+  }
+  bench("Light::addToLightMap (x32)", size, iterations, [&]() {
+    for (map::Light* light : lights) light->addToLightMap(game.lightMap);
+  });
+
+  TCODImage ground(CON_W * 2, CON_H * 2);
+  bench("LightMap::applyToImage", size, iterations, [&]() {
+    game.lightMap.applyToImage(ground, 0, 0, CON_W * 2 - 1, CON_H * 2 - 1);
+  });
+  bench("LightMap::applyToImageOutdoor", size, iterations, [&]() { game.lightMap.applyToImageOutdoor(ground); });
+
+  // burning zones all over the viewport
+  for (int i = 0; i < 16; i++) {
+    game.startFireZone(game.xOffset + rnd.getInt(0, CON_W - 8), game.yOffset + rnd.getInt(0, CON_H - 8), 6, 6);
+  }
+  // the fire manager does nothing below its 0.05s update delay
+  bench("FireManager::update", size, iterations, [&]() { game.getFireManager()->update(0.05f); });
+  bench("FireManager::renderFire", size, iterations, [&]() { game.getFireManager()->renderFire(ground); });
+
+  game.startRipple(size / 2, size / 2 + 8);
+  bench("RippleManager::updateRipples", size, iterations, [&]() {
+    game.startRipple(size / 2, size / 2 + 8);
+    game.getRippleManager()->updateRipples(0.1f);
+  });
+
+  bench("CellularAutomata::generate", size, iterations, [&]() {
+    util::CellularAutomata ca(size * 2, size * 2, 45);
+    ca.generate(&util::CellularAutomata::CAFunc_cave, 1);
+  });
+
+  util::CloudBox* clouds = nullptr;
+  bench("CloudBox::CloudBox", size, std::max(1, iterations / 10), [&]() {
+    delete clouds;
+    clouds = new util::CloudBox(size * 2, size * 2);
+  });
+  // one second of wind regenerates one column
+  bench("CloudBox::update", size, iterations, [&]() { clouds->update(1.0f); });
+  delete clouds;
+
+  for (map::Light* light : lights) delete light;
+}
+
+int main(int argc, char* argv[]) {
+  config.run("data/cfg/config.txt", NULL);
+  mob::ConditionType::init();
+  util::TextGenerator::setGlobalFunction("NUMBER_TO_LETTER", new util::NumberToLetterFunc());
+  util::Powerup::init();
+  threadPool = new util::ThreadPool();
+  if (argc > 1) iterations = std::max(1, atoi(argv[1]));
+  saveGame.init();
+  saveGame.seed = 0;
+  rng = new TCODRandom(saveGame.seed, TCOD_RNG_CMWC);
+
+  BenchEngine game;
+  printf("%-28s %5s %6s %10s %10s %10s\n", "kernel", "size", "iter", "avg ms", "min ms", "median ms");
+  static const int sizes[] = {100, 200, 400};
+  for (int size : sizes) benchMapSize(game, size);
+
+  bench("WorldGenerator::generate", util::HM_WIDTH, 1, [&]() {
+    util::WorldGenerator worldGen;
+    TCODRandom wrnd(0);
+    worldGen.generate(&wrnd);
+  });
+  return 0;
+}
@@ -29,8 +29,11 @@
 #include <math.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "base/entity.hpp"
+#include "base/replay.hpp"
 #include "item.hpp"
 #include "main.hpp"
 #include "spell/fireball.hpp"
@@ -41,23 +44,103 @@ namespace base {
 GameEngine::GameEngine() : screen::Screen{0} { gameEngine = this; }
 
 void GameEngine::onActivate() {
+  static bool debug = config.getBoolProperty("config.debug");
   screen::Screen::onActivate();
+  showProfiler = debug;
   hitFlashAmount = 0.0f;
   firstFrame = true;
+  groundDirty.addAll();
   computeAspectRatio();
   gui.activate();
   stats = {};
   TCODConsole::mapAsciiCodeToFont(TCOD_CHAR_PROGRESSBAR, 26, 3);
   isUpdatingFireballs = false;
+  // recorded sessions start from a known random state
+  InputRecorder* recorder = InputRecorder::instance;
+  if (recorder && !recorder->isStarted() && getReplayName()) {
+    reseed(recorder->getSeed());
+    recorder->start(getReplayName(), newGame);
+  } else if (InputReplay::instance) {
+    reseed(InputReplay::instance->getSeed());
+  }
 }
 
 void GameEngine::onDeactivate() {
   screen::Screen::onDeactivate();
   gui.deactivate();
+  // only the first game screen is recorded
+  if (InputRecorder::instance && InputRecorder::instance->isStarted()) InputRecorder::finish();
+}
+
+void GameEngine::reseed(uint32_t seed) {
+  delete rng;
+  rng = new TCODRandom(seed, TCOD_RNG_CMWC);
+  // the default generator is used all over the place (fire, canopy, creatures...)
+  TCODRandom seeded(seed, TCOD_RNG_CMWC);
+  TCODRandom::getInstance()->restore(&seeded);
+}
+
+// FNV-1a hash of the simulation state, used to check that a replay has not diverged
+uint32_t GameEngine::computeStateHash() const {
+  uint32_t hash = 2166136261u;
+  auto mix = [&hash](float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    hash = (hash ^ bits) * 16777619u;
+  };
+  mix(player.x_);
+  mix(player.y_);
+  mix(player.life_);
+  if (dungeon) {
+    for (mob::Creature** it = dungeon->creatures.begin(); it != dungeon->creatures.end(); it++) {
+      mix((*it)->x_);
+      mix((*it)->y_);
+      mix((*it)->life_);
+    }
+  }
+  mix((float)fireballs.size());
+  return hash;
 }
 
 void GameEngine::onFontChange() { computeAspectRatio(); }
 
+void GameEngine::checkGroundChanges() {
+  int cloudRevision = dungeon->getCloudRevision();
+  int dx2 = (xOffset - groundxOffset) * 2;
+  int dy2 = (yOffset - groundyOffset) * 2;
+  if (dungeon != groundDungeon || cloudRevision != groundCloudRevision || abs(dx2) >= CON_W * 2 ||
+      abs(dy2) >= CON_H * 2) {
+    groundDirty.addAll();
+  } else if ((dx2 != 0 || dy2 != 0) && !groundDirty.isFull()) {
+    // the camera moved. shift the previous frame and only composite the new strips
+    scrollGround(dx2, dy2);
+    groundDirty.translate(-dx2, -dy2);
+    if (dx2 > 0) groundDirty.add(CON_W * 2 - dx2, 0, dx2, CON_H * 2);
+    if (dx2 < 0) groundDirty.add(0, 0, -dx2, CON_H * 2);
+    if (dy2 > 0) groundDirty.add(0, CON_H * 2 - dy2, CON_W * 2, dy2);
+    if (dy2 < 0) groundDirty.add(0, 0, CON_W * 2, -dy2);
+  }
+  groundDungeon = dungeon;
+  groundxOffset = xOffset;
+  groundyOffset = yOffset;
+  groundCloudRevision = cloudRevision;
+}
+
+void GameEngine::scrollGround(int dx2, int dy2) {
+  // pixel x,y takes the value of pixel x+dx2,y+dy2. iterate so that a pixel is read before being overwritten
+  int minx = std::max(0, -dx2);
+  int maxx = std::min(CON_W * 2, CON_W * 2 - dx2);
+  int miny = std::max(0, -dy2);
+  int maxy = std::min(CON_H * 2, CON_H * 2 - dy2);
+  for (int i = miny; i < maxy; i++) {
+    int y = dy2 > 0 ? i : miny + maxy - 1 - i;
+    for (int j = minx; j < maxx; j++) {
+      int x = dx2 > 0 ? j : minx + maxx - 1 - j;
+      ground.putPixel(x, y, ground.getPixel(x + dx2, y + dy2));
+    }
+  }
+}
+
 void GameEngine::recomputeCanopy(item::Item* it) {
   static const int treeRadius = config.getIntProperty("config.display.treeRadius");
   if (dungeon->canopy) {
@@ -68,6 +151,7 @@ void GameEngine::recomputeCanopy(item::Item* it) {
       r.y_ = std::max(0.0f, r.y_);
       r.w_ = std::min(gsl::narrow_cast<int>(dungeon->width * 2 - 1 - r.x_), r.w_);
       r.h_ = std::min(gsl::narrow_cast<int>(dungeon->height * 2 - 1 - r.y_), r.h_);
+      addDirtyGroundRect((int)r.x_, (int)r.y_, r.w_, r.h_);
       for (int x = (int)r.x_; x < (int)(r.x_ + r.w_); x++) {
         for (int y = (int)r.y_; y < (int)(r.y_ + r.h_); y++) {
           if (IN_RECTANGLE(x, y, dungeon->width * 2, dungeon->height * 2)) {
@@ -90,6 +174,7 @@ void GameEngine::recomputeCanopy(item::Item* it) {
       }
     } else {
       // reset the whole map
+      groundDirty.addAll();
       dungeon->canopy->clear(TCODColor::black);
       dungeon->restoreShadowBeforeTree();
       for (int x = dungeon->width - 1; x >= 0; x--) {
@@ -146,7 +231,8 @@ void GameEngine::setCanopy(int x, int y, const item::ItemType* treeType, const R
 void GameEngine::computeAspectRatio() {
   int charw, charh;
   TCODSystem::getCharSize(&charw, &charh);
-  aspectRatio = (float)(charw) / charh;
+  // no font loaded when running headless
+  aspectRatio = charh > 0 ? (float)(charw) / charh : 1.0f;
 }
 
 void GameEngine::hitFlash() {
@@ -165,6 +251,26 @@ TCODColor GameEngine::setSepia(const TCODColor& col, float coef) {
 bool GameEngine::update(float elapsed, TCOD_key_t k, TCOD_mouse_t mouse) {
   static float hitFlashDelay = config.getFloatProperty("config.display.hitFlashDelay");
   static TCODColor flashColor = config.getColorProperty("config.display.flashColor");
+  static bool debug = config.getBoolProperty("config.debug");
+  util::Profiler::newFrame();
+  nbUpdates++;
+  if (InputRecorder::instance && InputRecorder::instance->isStarted()) {
+    InputRecorder* recorder = InputRecorder::instance;
+    recorder->record({elapsed, k, mouse, current_held_keys}, recorder->needsHash() ? computeStateHash() : 0);
+  } else if (InputReplay::instance && InputReplay::instance->needsHash()) {
+    InputReplay::instance->checkHash(computeStateHash());
+  }
+  if (debug && k.lalt && !k.pressed) {
+    if (k.c == 'p') {
+      // debug mode : Alt-p = show/hide the profiler
+      showProfiler = !showProfiler;
+    } else if (k.c == 't') {
+      // debug mode : Alt-t = dump profiler traces
+      if (util::Profiler::dumpCsv("profile.csv") && util::Profiler::dumpChromeTrace("profile.json")) {
+        gui.log.info("Profiler traces saved to profile.csv and profile.json");
+      }
+    }
+  }
   packer.clear();
   if (fade_ == FADE_OFF) {
     if (hitFlashAmount > 0.0f) {
@@ -267,7 +373,14 @@ void GameEngine::updateFireballs(float elapsed) {
   fireballsToRemove.clearAndDelete();
 }
 
+void GameEngine::renderProfiler() {
+  if (showProfiler) util::Profiler::renderOverlay(TCODConsole::root, 0, 1);
+}
+
 void GameEngine::displayProgress(float prog) {
+  progress = prog;
+  // only the main thread can render. background threads just update the progress
+  if (headless || util::ThreadPool::isWorkerThread()) return;
   // printf ("==> %g \n",prog);
   int l = (int)(CON_W / 2 * prog);
   if (l > 0) {
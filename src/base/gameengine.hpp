@@ -25,6 +25,7 @@
  */
 #pragma once
 
+#include <atomic>
 #include <libtcod.hpp>
 #include <umbra/umbra.hpp>
 
@@ -37,12 +38,17 @@
 #include "spell/fireball.hpp"
 #include "ui/dialog.hpp"
 #include "ui/gui.hpp"
+#include "util/dirtyrects.hpp"
 #include "util/fire.hpp"
 #include "util/packer.hpp"
 #include "util/ripples.hpp"
 
 namespace base {
+class HeadlessRunner;
+
 class GameEngine : public screen::Screen {
+  friend class HeadlessRunner;
+
  public:
   GameEngine();
   ~GameEngine() = default;
@@ -63,6 +69,11 @@ class GameEngine : public screen::Screen {
   TCODImage ground{CON_W * 2, CON_H * 2};  // visible part of the ground
 
   map::LightMap lightMap{CON_W * 2, CON_H * 2};  // store light reaching each cell
+  // parts of the ground to composite again. the previous frame is reused elsewhere
+  util::DirtyRects groundDirty{CON_W * 2, CON_H * 2};
+  inline void addDirtyGroundRect(int dungeon2x, int dungeon2y, int w, int h) {
+    groundDirty.add(dungeon2x - xOffset * 2, dungeon2y - yOffset * 2, w, h);
+  }
   util::Packer packer{0, 0, CON_W, CON_H};
 
   inline float getFog(int x, int y) { return lightMap.getFog(x, y); }
@@ -99,6 +110,12 @@ class GameEngine : public screen::Screen {
   // base utilities. to be moved elsewhere
   static TCODColor setSepia(const TCODColor& col, float coef);
   void displayProgress(float prog);  // renders a progress bar and flush
+  inline float getProgress() const { return progress; }  // can be polled while generating in background
+
+  // input record/replay
+  virtual const char* getReplayName() const { return NULL; }  // NULL : cannot be replayed
+  uint32_t computeStateHash() const;
+  static void reseed(uint32_t seed);  // reset the random number generators
 
   ui::Gui gui{};
   float aspectRatio{};  // font char width / font char height
@@ -113,13 +130,25 @@ class GameEngine : public screen::Screen {
   int nbPause{};
   bool lookOn{};  // shit pressed
   bool firstFrame{true};
+  uint32_t nbUpdates{};  // deterministic frame count. background results are picked up at fixed updates
+  bool showProfiler{};  // frame time breakdown overlay (debug only)
+  bool headless{};  // no window (headless run or benchmark)
+  std::atomic<float> progress{0.0f};  // last value passed to displayProgress
   util::RippleManager* rippleManager{};
   util::FireManager* fireManager{};
   float hitFlashAmount{};
+  // view of the last composited ground
+  const map::Dungeon* groundDungeon{};
+  int groundxOffset{}, groundyOffset{};
+  int groundCloudRevision{};
 
   void onInitialise() override;
   void onActivate() override;
   void onDeactivate() override;
   void computeAspectRatio();
+  void renderProfiler();
+  void checkGroundChanges();  // the ground parts to composite after a scroll, a cloud move...
+  // the camera moved by dx2,dy2 2x pixels. shift the buffers reused between frames
+  virtual void scrollGround(int dx2, int dy2);
 };
 }  // namespace base
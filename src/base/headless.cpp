@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "base/headless.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "base/gameengine.hpp"
+#include "base/replay.hpp"
+#include "constants.hpp"
+#include "main.hpp"
+#include "screen/forest.hpp"
+#include "screen/treeBurner.hpp"
+
+namespace base {
+static float elapsedMs(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+HeadlessRunner::HeadlessRunner(GameEngine* game, float frameLength, bool doRender)
+    : game(game), frameLength(frameLength), doRender(doRender) {
+  // everything drawn on the root console goes to an off-screen console instead
+  offscreen = new TCODConsole(CON_W, CON_H);
+  savedRoot = TCODConsole::root;
+  TCODConsole::root = offscreen;
+}
+
+HeadlessRunner::~HeadlessRunner() {
+  TCODConsole::root = savedRoot;
+  delete offscreen;
+}
+
+void HeadlessRunner::activate(uint32_t seed, bool isNewGame) {
+  newGame = isNewGame;
+  saveGame.seed = seed;
+  GameEngine::reseed(seed);
+  auto t0 = std::chrono::steady_clock::now();
+  game->headless = true;
+  game->onInitialise();
+  game->onActivate();
+  printf("headless : activation %.1f ms (seed %u)\n", elapsedMs(t0), seed);
+}
+
+void HeadlessRunner::skipPrompts() {
+  if (game->player.name_.empty()) game->player.name_ = "headless";
+  while (game->isGamePaused()) game->resumeGame();
+}
+
+bool HeadlessRunner::step(float elapsed, TCOD_key_t k, TCOD_mouse_t mouse) {
+  auto t0 = std::chrono::steady_clock::now();
+  bool ret = game->update(elapsed, k, mouse);
+  float updateTime = elapsedMs(t0);
+  float renderTime = 0.0f;
+  if (ret && doRender) {
+    t0 = std::chrono::steady_clock::now();
+    game->render();
+    renderTime = elapsedMs(t0);
+  }
+  updateTimes.push_back(updateTime);
+  renderTimes.push_back(renderTime);
+  printf("frame %5d update %8.3f ms render %8.3f ms\n", getFrameCount() - 1, updateTime, renderTime);
+  return ret;
+}
+
+void HeadlessRunner::run(int nbFrames) {
+  TCOD_key_t k{};
+  TCOD_mouse_t mouse{};
+  for (int i = 0; i < nbFrames; i++) {
+    if (!step(frameLength, k, mouse)) break;
+  }
+}
+
+void HeadlessRunner::replay(InputReplay* replay) {
+  FrameInput input;
+  while (replay->next(&input)) {
+    current_held_keys = input.held;
+    if (!step(input.elapsed, input.key, input.mouse)) break;
+  }
+  current_held_keys = {};
+}
+
+void HeadlessRunner::printStats(const char* name, std::vector<float> times) {
+  if (times.empty()) return;
+  std::sort(times.begin(), times.end());
+  float total = 0.0f;
+  for (float t : times) total += t;
+  int n = (int)times.size();
+  printf(
+      "%-7s total %9.1f ms avg %7.3f min %7.3f median %7.3f p95 %7.3f max %7.3f\n",
+      name,
+      total,
+      total / n,
+      times[0],
+      times[n / 2],
+      times[std::min(n - 1, n * 95 / 100)],
+      times[n - 1]);
+}
+
+// frame time distribution, to compare runs of the same record
+void HeadlessRunner::printHistogram(const std::vector<float>& times) {
+  static const float bounds[] = {1.0f, 2.0f, 4.0f, 8.0f, 16.0f, 33.0f, 66.0f};
+  static const int NB_BUCKETS = sizeof(bounds) / sizeof(bounds[0]) + 1;
+  int counts[NB_BUCKETS] = {};
+  for (float t : times) {
+    int b = 0;
+    while (b < NB_BUCKETS - 1 && t >= bounds[b]) b++;
+    counts[b]++;
+  }
+  for (int b = 0; b < NB_BUCKETS; b++) {
+    float lo = b == 0 ? 0.0f : bounds[b - 1];
+    if (b < NB_BUCKETS - 1) {
+      printf("  %5.0f - %5.0f ms : %6d\n", lo, bounds[b], counts[b]);
+    } else {
+      printf("  %5.0f+        ms : %6d\n", lo, counts[b]);
+    }
+  }
+}
+
+void HeadlessRunner::printSummary() const {
+  std::vector<float> frameTimes(updateTimes.size());
+  for (size_t i = 0; i < updateTimes.size(); i++) frameTimes[i] = updateTimes[i] + renderTimes[i];
+  printf("headless : %d frames\n", getFrameCount());
+  printStats("update", updateTimes);
+  if (doRender) printStats("render", renderTimes);
+  printStats("frame", frameTimes);
+  printHistogram(frameTimes);
+}
+
+GameEngine* createHeadlessScreen(const char* name) {
+  if (strcmp(name, "treeburner") == 0) return new screen::TreeBurner();
+  if (strcmp(name, "forest") == 0) return new screen::ForestScreen();
+  return NULL;
+}
+
+// treeburner --headless <treeburner|forest> [nbFrames] [seed] [render]
+int runHeadless(int argc, char* argv[]) {
+  static const float timeScale = config.getFloatProperty("config.gameplay.timeScale");
+  const char* screenName = argc > 2 ? argv[2] : "treeburner";
+  int nbFrames = argc > 3 ? atoi(argv[3]) : 1000;
+  uint32_t seed = argc > 4 ? (uint32_t)atoi(argv[4]) : 0;
+  bool doRender = argc > 5 && strcmp(argv[5], "render") == 0;
+  GameEngine* game = createHeadlessScreen(screenName);
+  if (!game) {
+    printf("FATAL : unknown headless screen '%s'. Use treeburner or forest\n", screenName);
+    return 1;
+  }
+  {
+    // 60 fps, same time scale as the real game
+    HeadlessRunner runner(game, timeScale / 60.0f, doRender);
+    runner.activate(seed, true);
+    // no one to type a name or close a dialog here
+    runner.skipPrompts();
+    runner.run(nbFrames);
+    runner.printSummary();
+  }
+  if (config.getBoolProperty("config.debug")) {
+    util::Profiler::dumpCsv("profile.csv");
+    util::Profiler::dumpChromeTrace("profile.json");
+    printf("headless : profiler traces saved to profile.csv and profile.json\n");
+  }
+  return 0;
+}
+
+// treeburner --replay <file> [render]
+int runReplay(int argc, char* argv[]) {
+  static const float timeScale = config.getFloatProperty("config.gameplay.timeScale");
+  if (argc < 3) {
+    printf("FATAL : usage : treeburner --replay <file> [render]\n");
+    return 1;
+  }
+  bool doRender = argc > 3 && strcmp(argv[3], "render") == 0;
+  InputReplay replay;
+  if (!replay.load(argv[2])) {
+    printf("FATAL : cannot read input record %s\n", argv[2]);
+    return 1;
+  }
+  GameEngine* game = createHeadlessScreen(replay.getScreenName());
+  if (!game) {
+    printf("FATAL : unknown recorded screen '%s'\n", replay.getScreenName());
+    return 1;
+  }
+  if (!replay.isNewGame() && (!saveGame.load(PHASE_INIT) || saveGame.seed != replay.getSeed())) {
+    printf("FATAL : %s continues a savegame. data/sav/savegame.dat must be the one it was recorded over\n", argv[2]);
+    return 1;
+  }
+  InputReplay::instance = &replay;
+  {
+    // the recorded inputs fill the name prompt and close the dialogs
+    HeadlessRunner runner(game, timeScale / 60.0f, doRender);
+    runner.activate(replay.getSeed(), replay.isNewGame());
+    runner.replay(&replay);
+    runner.printSummary();
+  }
+  InputReplay::instance = NULL;
+  printf(
+      "replay : %d frames, %s\n",
+      replay.getNbFrames(),
+      replay.getNbDivergences() == 0 ? "no divergence" : "DIVERGED");
+  return replay.getNbDivergences() == 0 ? 0 : 2;
+}
+}  // namespace base
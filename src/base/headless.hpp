@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <libtcod.hpp>
+#include <vector>
+
+namespace base {
+class GameEngine;
+class InputReplay;
+
+// runs a game screen without window nor umbra main loop.
+// update() is stepped with a fixed frame length and render() optionally
+// draws into an off-screen console swapped in place of the root console.
+class HeadlessRunner {
+ public:
+  HeadlessRunner(GameEngine* game, float frameLength, bool doRender);
+  ~HeadlessRunner();
+
+  // isNewGame false to continue the savegame, which must already be loaded
+  void activate(uint32_t seed, bool isNewGame);
+  // fill the name prompt and close the dialogs that pause the game. only when nothing drives the inputs
+  void skipPrompts();
+  // run one frame. returns false when the screen wants to exit
+  bool step(float elapsed, TCOD_key_t k, TCOD_mouse_t mouse);
+  void run(int nbFrames);
+  // feed a recorded session instead of empty inputs
+  void replay(InputReplay* replay);
+  void printSummary() const;
+
+  inline int getFrameCount() const { return (int)updateTimes.size(); }
+
+ protected:
+  GameEngine* game = nullptr;
+  float frameLength;
+  bool doRender;
+  TCODConsole* offscreen = nullptr;
+  TCODConsole* savedRoot = nullptr;
+  std::vector<float> updateTimes;  // milliseconds
+  std::vector<float> renderTimes;  // milliseconds
+
+  static void printStats(const char* name, std::vector<float> times);
+  static void printHistogram(const std::vector<float>& times);
+};
+
+// headless screen from its replay name, NULL if unknown
+GameEngine* createHeadlessScreen(const char* name);
+// entry point for the --headless command line option
+int runHeadless(int argc, char* argv[]);
+// entry point for the --replay command line option
+int runReplay(int argc, char* argv[]);
+}  // namespace base
@@ -1,5 +1,6 @@
 #pragma once
 #include <SDL.h>
+#include <libtcod.hpp>
 
 #include <array>
 #include <tuple>
@@ -63,4 +64,21 @@ inline auto get_current_movement_dir() -> std::tuple<int, int> {
   }
   return {dx, dy};
 }
+
+/// @brief Keyboard state polled by the simulation, as opposed to key events.
+struct HeldKeys {
+  int dx;
+  int dy;
+  bool ctrl;
+  bool shift;
+};
+
+/// @brief Poll the held keys from the active keyboard state.
+inline auto poll_held_keys() -> HeldKeys {
+  const auto [dx, dy] = get_current_movement_dir();
+  return {dx, dy, TCODConsole::isKeyPressed(TCODK_CONTROL), TCODConsole::isKeyPressed(TCODK_SHIFT)};
+}
+
+/// @brief Held keys for the current frame. Polled once per frame, or fed by an input replay.
+inline HeldKeys current_held_keys{};
 }  // namespace base
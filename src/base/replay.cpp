@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "base/replay.hpp"
+
+#include <stdio.h>
+
+namespace base {
+InputRecorder* InputRecorder::instance = NULL;
+InputReplay* InputReplay::instance = NULL;
+
+enum {
+  KEY_PRESSED = 1,
+  KEY_LALT = 2,
+  KEY_LCTRL = 4,
+  KEY_LMETA = 8,
+  KEY_RALT = 16,
+  KEY_RCTRL = 32,
+  KEY_RMETA = 64,
+  KEY_SHIFT = 128,
+};
+
+enum {
+  MOUSE_LBUTTON = 1,
+  MOUSE_RBUTTON = 2,
+  MOUSE_MBUTTON = 4,
+  MOUSE_LBUTTON_PRESSED = 8,
+  MOUSE_RBUTTON_PRESSED = 16,
+  MOUSE_MBUTTON_PRESSED = 32,
+  MOUSE_WHEEL_UP = 64,
+  MOUSE_WHEEL_DOWN = 128,
+};
+
+enum {
+  HELD_CTRL = 16,
+  HELD_SHIFT = 32,
+};
+
+InputRecorder::InputRecorder(const char* filename, uint32_t seed) : filename(filename), seed(seed) { instance = this; }
+
+void InputRecorder::start(const char* screenName, bool isNewGame) {
+  zip.putInt(REPLAY_MAGIC_NUMBER);
+  zip.putInt(REPLAY_VERSION);
+  zip.putInt(seed);
+  zip.putString(screenName);
+  zip.putChar(isNewGame ? 1 : 0);
+  zip.putInt(REPLAY_HASH_INTERVAL);
+  started = true;
+}
+
+// 8 bytes per frame + 4 bytes per hash before compression
+void InputRecorder::record(const FrameInput& input, uint32_t stateHash) {
+  const TCOD_key_t& k = input.key;
+  const TCOD_mouse_t& m = input.mouse;
+  zip.putFloat(input.elapsed);
+  zip.putChar((char)k.vk);
+  zip.putChar(k.c);
+  zip.putChar(
+      (char)((k.pressed ? KEY_PRESSED : 0) | (k.lalt ? KEY_LALT : 0) | (k.lctrl ? KEY_LCTRL : 0) |
+             (k.lmeta ? KEY_LMETA : 0) | (k.ralt ? KEY_RALT : 0) | (k.rctrl ? KEY_RCTRL : 0) |
+             (k.rmeta ? KEY_RMETA : 0) | (k.shift ? KEY_SHIFT : 0)));
+  zip.putChar((char)m.cx);
+  zip.putChar((char)m.cy);
+  zip.putChar(
+      (char)((m.lbutton ? MOUSE_LBUTTON : 0) | (m.rbutton ? MOUSE_RBUTTON : 0) | (m.mbutton ? MOUSE_MBUTTON : 0) |
+             (m.lbutton_pressed ? MOUSE_LBUTTON_PRESSED : 0) | (m.rbutton_pressed ? MOUSE_RBUTTON_PRESSED : 0) |
+             (m.mbutton_pressed ? MOUSE_MBUTTON_PRESSED : 0) | (m.wheel_up ? MOUSE_WHEEL_UP : 0) |
+             (m.wheel_down ? MOUSE_WHEEL_DOWN : 0)));
+  const HeldKeys& h = input.held;
+  zip.putChar((char)((h.dx + 1) | ((h.dy + 1) << 2) | (h.ctrl ? HELD_CTRL : 0) | (h.shift ? HELD_SHIFT : 0)));
+  if (nbFrames % REPLAY_HASH_INTERVAL == 0) zip.putInt(stateHash);
+  nbFrames++;
+}
+
+void InputRecorder::save() {
+  if (!started) return;
+  zip.saveToFile(filename.c_str());
+  printf("Input record : %d frames saved to %s\n", nbFrames, filename.c_str());
+}
+
+void InputRecorder::finish() {
+  if (!instance) return;
+  instance->save();
+  delete instance;
+  instance = NULL;
+}
+
+bool InputReplay::load(const char* filename) {
+  if (!zip.loadFromFile(filename)) return false;
+  if ((uint32_t)zip.getInt() != REPLAY_MAGIC_NUMBER) {
+    printf("FATAL : %s is not an input record\n", filename);
+    return false;
+  }
+  int version = zip.getInt();
+  if (version != REPLAY_VERSION) {
+    printf("FATAL : %s : unsupported input record version %d\n", filename, version);
+    return false;
+  }
+  seed = (uint32_t)zip.getInt();
+  screenName = zip.getString();
+  newGame = zip.getChar() != 0;
+  hashInterval = zip.getInt();
+  return true;
+}
+
+bool InputReplay::next(FrameInput* input) {
+  if (zip.getRemainingBytes() == 0) return false;
+  TCOD_key_t& k = input->key;
+  TCOD_mouse_t& m = input->mouse;
+  k = {};
+  m = {};
+  input->elapsed = zip.getFloat();
+  k.vk = (TCOD_keycode_t)(uint8_t)zip.getChar();
+  k.c = zip.getChar();
+  int keyFlags = (uint8_t)zip.getChar();
+  k.pressed = (keyFlags & KEY_PRESSED) != 0;
+  k.lalt = (keyFlags & KEY_LALT) != 0;
+  k.lctrl = (keyFlags & KEY_LCTRL) != 0;
+  k.lmeta = (keyFlags & KEY_LMETA) != 0;
+  k.ralt = (keyFlags & KEY_RALT) != 0;
+  k.rctrl = (keyFlags & KEY_RCTRL) != 0;
+  k.rmeta = (keyFlags & KEY_RMETA) != 0;
+  k.shift = (keyFlags & KEY_SHIFT) != 0;
+  m.cx = zip.getChar();
+  m.cy = zip.getChar();
+  int mouseFlags = (uint8_t)zip.getChar();
+  m.lbutton = (mouseFlags & MOUSE_LBUTTON) != 0;
+  m.rbutton = (mouseFlags & MOUSE_RBUTTON) != 0;
+  m.mbutton = (mouseFlags & MOUSE_MBUTTON) != 0;
+  m.lbutton_pressed = (mouseFlags & MOUSE_LBUTTON_PRESSED) != 0;
+  m.rbutton_pressed = (mouseFlags & MOUSE_RBUTTON_PRESSED) != 0;
+  m.mbutton_pressed = (mouseFlags & MOUSE_MBUTTON_PRESSED) != 0;
+  m.wheel_up = (mouseFlags & MOUSE_WHEEL_UP) != 0;
+  m.wheel_down = (mouseFlags & MOUSE_WHEEL_DOWN) != 0;
+  int held = (uint8_t)zip.getChar();
+  input->held.dx = (held & 3) - 1;
+  input->held.dy = ((held >> 2) & 3) - 1;
+  input->held.ctrl = (held & HELD_CTRL) != 0;
+  input->held.shift = (held & HELD_SHIFT) != 0;
+  hasHash = (frame % hashInterval == 0);
+  if (hasHash) expectedHash = (uint32_t)zip.getInt();
+  frame++;
+  return true;
+}
+
+void InputReplay::checkHash(uint32_t stateHash) {
+  hasHash = false;
+  if (stateHash != expectedHash) {
+    if (nbDivergences == 0) {
+      printf("Replay diverged at frame %d : state hash %08x, recorded %08x\n", frame - 1, stateHash, expectedHash);
+    }
+    nbDivergences++;
+  }
+}
+}  // namespace base
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <libtcod.hpp>
+#include <stdint.h>
+
+#include <string>
+
+#include "base/movement.hpp"
+
+namespace base {
+#define REPLAY_MAGIC_NUMBER 0x54425250
+#define REPLAY_VERSION 2
+// a state hash is stored every REPLAY_HASH_INTERVAL frames
+#define REPLAY_HASH_INTERVAL 60
+
+// everything the simulation reads from the player during one frame
+struct FrameInput {
+  float elapsed;
+  TCOD_key_t key;
+  TCOD_mouse_t mouse;
+  HeldKeys held;
+};
+
+// records the inputs of a game session to a compressed file
+class InputRecorder {
+ public:
+  static InputRecorder* instance;  // non NULL while recording
+
+  InputRecorder(const char* filename, uint32_t seed);
+  // called once the recorded screen is known. isNewGame is false when the session continues the savegame
+  void start(const char* screenName, bool isNewGame);
+  void record(const FrameInput& input, uint32_t stateHash);
+  void save();
+  // save and stop recording
+  static void finish();
+  inline bool isStarted() const { return started; }
+  inline bool needsHash() const { return nbFrames % REPLAY_HASH_INTERVAL == 0; }
+  inline uint32_t getSeed() const { return seed; }
+
+ protected:
+  std::string filename;
+  uint32_t seed;
+  int nbFrames = 0;
+  bool started = false;
+  TCODZip zip;
+};
+
+// reads a recorded session back
+class InputReplay {
+ public:
+  static InputReplay* instance;  // non NULL while replaying
+
+  InputReplay() = default;
+  bool load(const char* filename);
+  // read the next frame. returns false at the end of the record
+  bool next(FrameInput* input);
+  // compare the state hash with the recorded one when there is one for this frame
+  void checkHash(uint32_t stateHash);
+  inline bool needsHash() const { return hasHash; }
+  inline uint32_t getSeed() const { return seed; }
+  inline const char* getScreenName() const { return screenName.c_str(); }
+  // false when the recorded session continued the savegame. it must be replayed over the same savegame
+  inline bool isNewGame() const { return newGame; }
+  inline int getNbFrames() const { return frame; }
+  inline int getNbDivergences() const { return nbDivergences; }
+
+ protected:
+  uint32_t seed = 0;
+  std::string screenName;
+  bool newGame = true;
+  int hashInterval = REPLAY_HASH_INTERVAL;
+  int frame = 0;
+  int nbDivergences = 0;
+  bool hasHash = false;
+  uint32_t expectedHash = 0;
+  TCODZip zip;
+};
+}  // namespace base
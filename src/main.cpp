@@ -28,6 +28,8 @@
 #include <stdio.h>
 #include <time.h>
 
+#include "base/headless.hpp"
+#include "base/replay.hpp"
 #include "screen/end.hpp"
 #include "screen/forest.hpp"
 #include "screen/game.hpp"
@@ -35,25 +37,6 @@
 #include "screen/treeBurner.hpp"
 #include "util/powerup.hpp"
 
-TCODNoise noise1d(1);
-TCODNoise noise2d(2);
-TCODNoise noise3d(3);
-TCODRandom* rng = nullptr;
-bool mouseControl = false;
-bool newGame = false;
-base::SaveGame saveGame;
-base::UserPref userPref;
-UmbraEngine engine("./data/cfg/umbra.txt", UMBRA_REGISTER_ALL);
-TCODImage background("./data/img/background.png");
-TCODParser config;
-util::Sound sound;
-util::ThreadPool* threadPool = nullptr;
-
-map::HDRColor getHDRColorProperty(const TCODParser& parser, const char* name) {
-  TCODList<float> l(parser.getListProperty(name, TCOD_TYPE_FLOAT));
-  return map::HDRColor(l.get(0), l.get(1), l.get(2));
-}
-
 class ModuleFactory : public UmbraModuleFactory {
  public:
   UmbraModule* createModule(const char* name) {
@@ -203,6 +186,16 @@ int main(int argc, char* argv[]) {
 
   threadPool = new util::ThreadPool();
 
+  if (argc >= 2 && strcmp(argv[1], "--headless") == 0) {
+    // fixed timestep simulation without window
+    saveGame.init();
+    return base::runHeadless(argc, argv);
+  } else if (argc >= 2 && strcmp(argv[1], "--replay") == 0) {
+    // replay a recorded session without window
+    saveGame.init();
+    return base::runReplay(argc, argv);
+  }
+
   // initialise random number generator
   if (!saveGame.load(base::PHASE_INIT)) {
     newGame = true;
@@ -217,12 +210,17 @@ int main(int argc, char* argv[]) {
   }
   userPref.nbLaunches++;
   rng = new TCODRandom(saveGame.seed, TCOD_RNG_CMWC);
+  if (argc >= 3 && strcmp(argv[1], "--record") == 0) {
+    // record the inputs of the next game screen
+    new base::InputRecorder(argv[2], saveGame.seed);
+  }
 
   engine.loadModuleConfiguration("data/cfg/modules.cfg", new ModuleFactory());
 
   sound.initialize();
   if (engine.initialise(TCOD_RENDERER_SDL2)) {
     engine.run();
+    base::InputRecorder::finish();
     // saveGame.save();
     userPref.save();
     return 0;
@@ -33,6 +33,7 @@
 #include "base/userpref.hpp"
 #include "map/cell.hpp"
 #include "map/lightmap.hpp"
+#include "util/profiler.hpp"
 #include "util/sound.hpp"
 #include "util/threadpool.hpp"
 
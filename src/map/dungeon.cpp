@@ -25,10 +25,13 @@
  */
 #include "map/dungeon.hpp"
 
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <fmt/core.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "helpers.hpp"
 #include "main.hpp"
@@ -52,10 +55,51 @@ void Dungeon::computeSpawnSources() {
       if (map->isWalkable(x, y)) spawnSources.push(x | (y << 16));
     }
   }
+  spawnFieldx = spawnFieldy = -1;
 }
 
+// a single dijkstra from x,y gives the path distance of the spawn sources around.
+// the search is limited to a box of spawnFieldRange cells, enlarged until it contains enough sources
+void Dungeon::sortSpawnSources(int x, int y) {
+  static float spawnFieldRange = config.getFloatProperty("config.aidirector.spawnFieldRange");
+  // more than the 3 candidates. the closest ones may be in the player fov
+  static const int MIN_SPAWN_SOURCES = 8;
+  PROFILE("spawnField");
+  const float* costs = getWalkCosts();
+  for (float range = spawnFieldRange;; range *= 2) {
+    // walk costs are at least 1 per cell. nothing farther than range cells can be reached
+    int irange = (int)range + 1;
+    int minx = std::max(0, x - irange);
+    int miny = std::max(0, y - irange);
+    int maxx = std::min(width - 1, x + irange);
+    int maxy = std::min(height - 1, y + irange);
+    spawnField.begin(minx, miny, maxx - minx + 1, maxy - miny + 1);
+    spawnField.addSource(x, y);
+    spawnField.compute(costs + minx + miny * width, width, range);
+    sortedSpawnSources.clear();
+    for (int* it = spawnSources.begin(); it != spawnSources.end(); it++) {
+      int sx = (*it) & 0xFFFF;
+      int sy = (*it) >> 16;
+      if (spawnField.isInside(sx, sy) && spawnField.isReached(sx, sy)) sortedSpawnSources.push_back(*it);
+    }
+    bool wholeMap = minx == 0 && miny == 0 && maxx == width - 1 && maxy == height - 1;
+    if ((int)sortedSpawnSources.size() >= MIN_SPAWN_SOURCES || wholeMap) break;
+  }
+  std::sort(sortedSpawnSources.begin(), sortedSpawnSources.end(), [this](int a, int b) {
+    return spawnField.getDistance(a & 0xFFFF, a >> 16) < spawnField.getDistance(b & 0xFFFF, b >> 16);
+  });
+  spawnFieldx = x;
+  spawnFieldy = y;
+}
+
+// source of the transparency revisions. maps can be generated in background
+static std::atomic<uint32_t> lastTransparencyRevision{0};
+static std::atomic<uint32_t> lastWalkabilityRevision{0};
+
 // allocate all data
 void Dungeon::initData(util::CaveGenerator* caveGen) {
+  transparencyRevision = ++lastTransparencyRevision;
+  walkabilityRevision = ++lastWalkabilityRevision;
   cells = new map::Cell[width * height];
   subcells = new map::SubCell[width * height * 4];
   stairx = stairy = -1;
@@ -75,6 +119,16 @@ void Dungeon::initData(util::CaveGenerator* caveGen) {
   hmap = new TCODHeightMap(width * 2, height * 2);
   smap = new TCODHeightMap(width * 2, height * 2);
   smapBeforeTree = new TCODHeightMap(width * 2, height * 2);
+  fov2x.resize(width * 2, height * 2);
+  fov1x.resize(width, height);
+  staticLightsDirty = util::DirtyRects(width * 2, height * 2);
+  transparencyDirty = util::DirtyRects(width * 2, height * 2);
+  clearLightIndex();
+  lightBucketsWidth = (width * 2 + LIGHT_BUCKET_SIZE - 1) / LIGHT_BUCKET_SIZE;
+  lightBucketsHeight = (height * 2 + LIGHT_BUCKET_SIZE - 1) / LIGHT_BUCKET_SIZE;
+  lightBuckets.resize(lightBucketsWidth * lightBucketsHeight);
+  gridsReady = false;
+  for (auto& grid : costGrids) grid = nullptr;
   if (!caveGen) gameEngine->displayProgress(0.1f);
   isUpdatingItems = false;
   isUpdatingCreatures = false;
@@ -90,6 +144,13 @@ void Dungeon::cleanData() {
   delete smap;
   delete smapBeforeTree;
   if (clouds) delete clouds;
+  delete staticLightLayer;
+  clearLightIndex();
+  // the searches already running keep their own snapshot. this dungeon won't modify its grids anymore
+  for (auto& request : pathRequests) request->cancel();
+  pathRequests.clear();
+  for (map::ClusterGraph* graph : pathGraphs) delete graph;
+  delete pathFinder;
 }
 
 Dungeon::Dungeon(int level, util::CaveGenerator* caveGen) : level(level), ambient(TCODColor::black) {
@@ -225,17 +286,202 @@ void Dungeon::updateLights(float elapsed) {
   }
 }
 
+void Dungeon::addLight(map::Light* light) {
+  lights.push(light);
+  indexLight(light);
+  changedLights.push_back(light);
+}
+
+void Dungeon::removeLight(map::Light* light) {
+  lights.removeFast(light);
+  unindexLight(light);
+  changedLights.erase(std::remove(changedLights.begin(), changedLights.end(), light), changedLights.end());
+  if (light->baked) staticLightsDirty.add(light->getBakedArea());
+}
+
+void Dungeon::moveLight(map::Light* light, float x, float y) {
+  light->setPos(x, y);
+  // dynamic lights and lights out of the dungeon are not in the buckets
+  if (light->lightBucket == -1) return;
+  if (getLightBucket(light) != light->lightBucket) {
+    unindexLight(light);
+    indexLight(light);
+  }
+  if (light->hasChangedSinceBake()) changedLights.push_back(light);
+}
+
+// lights index bucket containing the light position. -1 for dynamic lights
+int Dungeon::getLightBucket(const map::Light* light) const {
+  if (light->dynamic) return -1;
+  int bx = std::clamp((int)light->x_ / LIGHT_BUCKET_SIZE, 0, lightBucketsWidth - 1);
+  int by = std::clamp((int)light->y_ / LIGHT_BUCKET_SIZE, 0, lightBucketsHeight - 1);
+  return bx + by * lightBucketsWidth;
+}
+
+void Dungeon::indexLight(map::Light* light) {
+  light->lightBucket = getLightBucket(light);
+  if (light->lightBucket == -1) {
+    dynamicLights.push_back(light);
+  } else {
+    lightBuckets[light->lightBucket].push_back(light);
+    maxIndexedLightRange = std::max(maxIndexedLightRange, light->range);
+  }
+}
+
+void Dungeon::unindexLight(map::Light* light) {
+  int bucketIndex = light->lightBucket;
+  std::vector<map::Light*>& bucket = bucketIndex == -1 ? dynamicLights : lightBuckets[bucketIndex];
+  auto it = std::find(bucket.begin(), bucket.end(), light);
+  if (it != bucket.end()) {
+    *it = bucket.back();
+    bucket.pop_back();
+  }
+  light->lightBucket = -1;
+  // the largest light is gone. don't let it widen the next searches
+  if (bucketIndex != -1 && light->range >= maxIndexedLightRange) {
+    maxIndexedLightRange = 0.0f;
+    for (const auto& lightBucket : lightBuckets) {
+      for (const map::Light* other : lightBucket) maxIndexedLightRange = std::max(maxIndexedLightRange, other->range);
+    }
+  }
+}
+
+void Dungeon::clearLightIndex() {
+  for (auto& bucket : lightBuckets) {
+    for (map::Light* light : bucket) light->lightBucket = -1;
+  }
+  lightBuckets.clear();
+  lightBucketsWidth = lightBucketsHeight = 0;
+  dynamicLights.clear();
+  visibleLights.clear();
+  changedLights.clear();
+  maxIndexedLightRange = 0.0f;
+}
+
+// lights that can reach the dungeon 2x rectangle
+void Dungeon::collectVisibleLights(int minx2x, int miny2x, int maxx2x, int maxy2x) {
+  visibleLights.clear();
+  auto isVisible = [&](const map::Light* light) {
+    return light->x_ + light->range >= minx2x && light->x_ - light->range <= maxx2x &&
+           light->y_ + light->range >= miny2x && light->y_ - light->range <= maxy2x;
+  };
+  for (map::Light* light : dynamicLights) {
+    if (isVisible(light)) visibleLights.push_back(light);
+  }
+  // a light in a bucket can reach maxIndexedLightRange cells around the bucket
+  int range = (int)maxIndexedLightRange + 1;
+  int bminx = std::max(0, (minx2x - range) / LIGHT_BUCKET_SIZE);
+  int bminy = std::max(0, (miny2x - range) / LIGHT_BUCKET_SIZE);
+  int bmaxx = std::min(lightBucketsWidth - 1, (maxx2x + range) / LIGHT_BUCKET_SIZE);
+  int bmaxy = std::min(lightBucketsHeight - 1, (maxy2x + range) / LIGHT_BUCKET_SIZE);
+  for (int by = bminy; by <= bmaxy; by++) {
+    for (int bx = bminx; bx <= bmaxx; bx++) {
+      for (map::Light* light : lightBuckets[bx + by * lightBucketsWidth]) {
+        if (isVisible(light)) visibleLights.push_back(light);
+      }
+    }
+  }
+}
+
+static bool isIntersecting(const std::vector<base::Rect>& rects, const base::Rect& r) {
+  for (const base::Rect& rect : rects) {
+    if (rect.isIntersecting(r)) return true;
+  }
+  return false;
+}
+
+// rebake the parts of the static light layer hit by a changed light or a transparency change
+void Dungeon::updateStaticLightLayer() {
+  for (map::Light* light : changedLights) {
+    if (light->baked != light->isStatic() || (light->baked && light->hasChangedSinceBake())) {
+      if (light->baked) staticLightsDirty.add(light->getBakedArea());
+      if (light->isStatic()) staticLightsDirty.add(light->getLitArea());
+    }
+  }
+  changedLights.clear();
+  if (staticLightsRevision != transparencyRevision && transparencyDirty.isEmpty()) transparencyDirty.addAll();
+  if (staticLightsDirty.isEmpty() && transparencyDirty.isEmpty()) return;
+  PROFILE("bakeStaticLights");
+  const std::vector<base::Rect>& transparencyRects = transparencyDirty.getRects();
+  if (!staticLightLayer && !staticLightsDirty.isEmpty()) {
+    staticLightLayer = new map::LightMap(width * 2, height * 2);
+    staticLightsDirty.addAll();
+  }
+  // a transparency change can cast a shadow anywhere in the range of a light
+  for (map::Light** it = lights.begin(); it != lights.end(); it++) {
+    map::Light* light = *it;
+    if (light->isStatic() && isIntersecting(transparencyRects, light->getLitArea())) {
+      staticLightsDirty.add(light->getLitArea());
+    }
+  }
+  // the parts are baked one after the other. they must not overlap
+  std::vector<base::Rect> parts = staticLightsDirty.getRects();
+  for (bool merged = true; merged;) {
+    merged = false;
+    for (size_t i = 0; i < parts.size() && !merged; i++) {
+      for (size_t j = i + 1; j < parts.size() && !merged; j++) {
+        if (!parts[i].isIntersecting(parts[j])) continue;
+        parts[i].merge(parts[j]);
+        parts.erase(parts.begin() + j);
+        merged = true;
+      }
+    }
+  }
+  for (const base::Rect& part : parts) {
+    staticLightLayer->clear(TCODColor::black, (int)part.x_, (int)part.y_, part.w_, part.h_);
+  }
+  nbBakedLights = 0;
+  for (map::Light** it = lights.begin(); it != lights.end(); it++) {
+    map::Light* light = *it;
+    light->baked = light->isStatic();
+    if (!light->baked) continue;
+    base::Rect area = light->getLitArea();
+    if (!isIntersecting(transparencyRects, area)) light->keepFov(staticLightsRevision, transparencyRevision);
+    for (const base::Rect& part : parts) {
+      if (part.isIntersecting(area)) light->addToLayer(this, staticLightLayer, part);
+    }
+    nbBakedLights++;
+  }
+  staticLightsDirty.clear();
+  transparencyDirty.clear();
+  staticLightsRevision = transparencyRevision;
+}
+
 void Dungeon::renderLightsToLightMap(
     map::LightMap& lightMap, int* minx, int* miny, int* maxx, int* maxy, bool clearMap) {
+  PROFILE("renderLightsToLightMap");
   int minx2x = width * 2 - 1;
   int maxx2x = 0;
   int miny2x = height * 2 - 1;
   int maxy2x = 0;
   if (clearMap) lightMap.clear(ambient);
-  for (map::Light** it = lights.begin(); it != lights.end(); it++) {
+  updateStaticLightLayer();
+  if (nbBakedLights > 0) {
+    // copy the visible part of the static light layer
+    int xOffset = gameEngine->xOffset * 2;
+    int yOffset = gameEngine->yOffset * 2;
+    int lminx = std::max(0, -xOffset);
+    int lminy = std::max(0, -yOffset);
+    int lmaxx = std::min(lightMap.width, width * 2 - xOffset);
+    int lmaxy = std::min(lightMap.height, height * 2 - yOffset);
+    std::vector<float> fovMask(std::max(0, lmaxx - lminx));
+    for (int y = lminy; y < lmaxy; y++) {
+      int dungeon2y = y + yOffset;
+      for (int x = lminx; x < lmaxx; x++) {
+        fovMask[x - lminx] = isInFov2x(x + xOffset, dungeon2y) ? 1.0f : 0.0f;
+      }
+      lightMap.addRow2x(lminx, y, *staticLightLayer, lminx + xOffset, dungeon2y, lmaxx - lminx, fovMask.data());
+    }
+  }
+  collectVisibleLights(
+      gameEngine->xOffset * 2,
+      gameEngine->yOffset * 2,
+      gameEngine->xOffset * 2 + lightMap.width - 1,
+      gameEngine->yOffset * 2 + lightMap.height - 1);
+  for (map::Light* light : visibleLights) {
     int light_minx, light_maxx, light_miny, light_maxy;
-    (*it)->addToLightMap(lightMap);
-    (*it)->getDungeonPart(&light_minx, &light_miny, &light_maxx, &light_maxy);
+    if (!light->baked) light->addToLightMap(lightMap);
+    light->getDungeonPart(&light_minx, &light_miny, &light_maxx, &light_maxy);
     if (minx2x > light_minx) minx2x = light_minx;
     if (maxx2x < light_maxx) maxx2x = light_maxx;
     if (miny2x > light_miny) miny2x = light_miny;
@@ -252,10 +498,17 @@ void Dungeon::renderLightsToImage(TCODImage& img, int* minx, int* miny, int* max
   int maxx2x = 0;
   int miny2x = height * 2 - 1;
   int maxy2x = 0;
-  for (map::Light** it = lights.begin(); it != lights.end(); it++) {
+  int iw, ih;
+  img.getSize(&iw, &ih);
+  collectVisibleLights(
+      gameEngine->xOffset * 2,
+      gameEngine->yOffset * 2,
+      gameEngine->xOffset * 2 + iw - 1,
+      gameEngine->yOffset * 2 + ih - 1);
+  for (map::Light* light : visibleLights) {
     int light_minx, light_maxx, light_miny, light_maxy;
-    (*it)->addToImage(img);
-    (*it)->getDungeonPart(&light_minx, &light_miny, &light_maxx, &light_maxy);
+    light->addToImage(img);
+    light->getDungeonPart(&light_minx, &light_miny, &light_maxx, &light_maxy);
     if (minx2x > light_minx) minx2x = light_minx;
     if (maxx2x < light_maxx) maxx2x = light_maxx;
     if (miny2x > light_miny) miny2x = light_miny;
@@ -363,11 +616,33 @@ TCODColor Dungeon::getShadedGroundColor(int x2, int y2) const {
   return col;
 }
 
-void Dungeon::getClosestSpawnSource(int x, int y, int* ssx, int* ssy) const {
+void Dungeon::getClosestSpawnSource(int x, int y, int* ssx, int* ssy) {
+  static int spawnFieldUpdateDist = config.getIntProperty("config.aidirector.spawnFieldUpdateDist");
+  // the walkability changes (burning trees...) don't trigger a new search. the order stays close enough
+  if (spawnFieldx == -1 || std::max(std::abs(x - spawnFieldx), std::abs(y - spawnFieldy)) >= spawnFieldUpdateDist) {
+    sortSpawnSources(x, y);
+  }
+  // return one of the 3 closest sources (path distance). only the visible ones are skipped
+  int candidates[3];
+  int nbCandidates = 0;
+  for (int i = 0; i < (int)sortedSpawnSources.size() && nbCandidates < 3; i++) {
+    int sx = sortedSpawnSources[i] & 0xFFFF;
+    int sy = sortedSpawnSources[i] >> 16;
+    if (map->isInFov(sx, sy) && getMemory(sx, sy)) {
+      // cannot spawn from a visible spawnsource
+      continue;
+    }
+    candidates[nbCandidates++] = sortedSpawnSources[i];
+  }
+  if (nbCandidates > 0) {
+    int best = candidates[TCODRandom::getInstance()->getInt(0, nbCandidates - 1)];
+    *ssx = best & 0xFFFF;
+    *ssy = best >> 16;
+    return;
+  }
+  // no reachable source. fall back to the straight distance
   int dist = 1000000;
   TCODList<int> bests;
-  TCODPath path(map);
-  // get the closest sources (straight distance)
   for (int* it = spawnSources.begin(); it != spawnSources.end(); it++) {
     int sx = (*it) & 0xFFFF;
     int sy = (*it) >> 16;
@@ -381,20 +656,6 @@ void Dungeon::getClosestSpawnSource(int x, int y, int* ssx, int* ssy) const {
       bests.push(*it);
     }
   }
-  // now check the path distance for the 5 bests
-  /*
-  dist=1000000;
-  TCODList<int> bests2;
-  for (int i=0; i < 5; i++ ) {
-          int best=bests.pop();
-          int sx=best&0xFFFF;
-          int sy=best>>16;
-          if (path.compute(x,y,sx,sy) && path.size()<dist) {
-                  dist=path.size();
-                  bests2.push(best);
-          }
-  }
-  */
   // return one of the 3 bests
   int b = TCODRandom::getInstance()->getInt(1, std::min(3, bests.size()));
   int best = bests.get(bests.size() - b);
@@ -566,6 +827,7 @@ void Dungeon::renderSubcellCreatures(map::LightMap& lightMap) {
 }
 
 void Dungeon::updateCreatures(float elapsed) {
+  PROFILE("updateCreatures");
   // can't use iterator because the boss update function summon creatures,
   // which may result in creatures reallocation
   TCODList<mob::Creature*> toDelete;
@@ -689,20 +951,196 @@ void Dungeon::computeWalkTransp(int x, int y) {
 }
 
 void Dungeon::setProperties(int x, int y, bool transparent, bool walkable) {
+  if (map->isTransparent(x, y) != transparent) {
+    transparencyRevision = ++lastTransparencyRevision;
+    transparencyDirty.add(x * 2, y * 2, 2, 2);
+  }
+  updateWalkCost(x, y, walkable);
   map->setProperties(x, y, transparent, walkable);
   map2x->setProperties(x * 2, y * 2, transparent, walkable);
   map2x->setProperties(x * 2 + 1, y * 2, transparent, walkable);
   map2x->setProperties(x * 2, y * 2 + 1, transparent, walkable);
   map2x->setProperties(x * 2 + 1, y * 2 + 1, transparent, walkable);
+  setGridProperties(x, y, transparent, walkable);
 }
 
 void Dungeon::setWalkable(int x, int y, bool walkable) {
   bool transp = map->isTransparent(x, y);
+  updateWalkCost(x, y, walkable);
   map->setProperties(x, y, transp, walkable);
   map2x->setProperties(x * 2, y * 2, transp, walkable);
   map2x->setProperties(x * 2 + 1, y * 2, transp, walkable);
   map2x->setProperties(x * 2, y * 2 + 1, transp, walkable);
   map2x->setProperties(x * 2 + 1, y * 2 + 1, transp, walkable);
+  setGridProperties(x, y, transp, walkable);
+}
+
+void Dungeon::buildGrids() {
+  transparent2x.resize(width * 2, height * 2);
+  walkable2x.resize(width * 2, height * 2);
+  for (int y = 0; y < height * 2; y++) {
+    for (int x = 0; x < width * 2; x++) {
+      transparent2x.set(x, y, map2x->isTransparent(x, y));
+      walkable2x.set(x, y, map2x->isWalkable(x, y));
+    }
+  }
+  gridsReady = true;
+}
+
+void Dungeon::setGridProperties(int x, int y, bool transparent, bool walkable) {
+  if (!gridsReady) return;
+  for (int i = 0; i < 4; i++) {
+    transparent2x.set(x * 2 + (i & 1), y * 2 + (i >> 1), transparent);
+    walkable2x.set(x * 2 + (i & 1), y * 2 + (i >> 1), walkable);
+  }
+}
+
+const util::BitGrid& Dungeon::getTransparencyGrid2x() {
+  if (!gridsReady) buildGrids();
+  return transparent2x;
+}
+
+const util::BitGrid& Dungeon::getWalkabilityGrid2x() {
+  if (!gridsReady) buildGrids();
+  return walkable2x;
+}
+
+float Dungeon::getPolicyCost(int x, int y, bool walkable, map::PathCostPolicy policy) const {
+  if (!walkable) return 0.0f;
+  const map::TerrainType& terrain = map::terrainTypes[getTerrainType(x, y)];
+  switch (policy) {
+    case map::PATH_COST_UNIFORM:
+      return 1.0f;
+    case map::PATH_COST_AVOID_WATER:
+      return terrain.ripples ? terrain.walkCost * 3 : terrain.walkCost;  // try to avoid getting wet!
+    case map::PATH_COST_WATER_ONLY:
+      return terrain.ripples ? 1.0f : 0.0f;
+    default:
+      return terrain.walkCost;
+  }
+}
+
+// keep the cost grids in sync with the map. called before the map is updated
+void Dungeon::updateWalkCost(int x, int y, bool walkable) {
+  if (!costGrids[map::PATH_COST_TERRAIN]) {
+    if (map->isWalkable(x, y) != walkable) walkabilityRevision = ++lastWalkabilityRevision;
+    return;
+  }
+  bool changed = false;
+  for (int i = 0; i < map::NB_PATH_COST_POLICIES; i++) {
+    std::shared_ptr<map::CostGrid>& grid = costGrids[i];
+    if (!grid) continue;
+    float cost = getPolicyCost(x, y, walkable, (map::PathCostPolicy)i);
+    if ((*grid)[x + y * width] == cost) continue;
+    // the cached snapshot is stale now. drop it so that only live requests keep the grid shared
+    pathSnapshot.reset();
+    // a path request still uses this grid
+    if (grid.use_count() > 1) releasePathRequests();
+    if (grid.use_count() > 1) grid = std::make_shared<map::CostGrid>(*grid);
+    (*grid)[x + y * width] = cost;
+    if (pathGraphs[i]) pathGraphs[i]->setDirty(x, y);
+    changed = true;
+  }
+  if (changed) walkabilityRevision = ++lastWalkabilityRevision;
+}
+
+const float* Dungeon::getCostGrid(map::PathCostPolicy policy) {
+  // the terrain grid is always built first. updateWalkCost relies on it
+  if (policy != map::PATH_COST_TERRAIN) getCostGrid(map::PATH_COST_TERRAIN);
+  std::shared_ptr<map::CostGrid>& grid = costGrids[policy];
+  if (!grid) {
+    grid = std::make_shared<map::CostGrid>(width * height);
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        (*grid)[x + y * width] = getPolicyCost(x, y, map->isWalkable(x, y), policy);
+      }
+    }
+  }
+  return grid->data();
+}
+
+const util::FlowField& Dungeon::getPlayerFlowField() {
+  static float flowFieldRange = config.getFloatProperty("config.creatures.flowFieldRange");
+  const float* costs = getWalkCosts();
+  int px = (int)gameEngine->player.x_;
+  int py = (int)gameEngine->player.y_;
+  if (px != playerFlowx || py != playerFlowy || playerFlowRevision != walkabilityRevision) {
+    PROFILE("playerFlowField");
+    playerFlow.begin(width, height);
+    playerFlow.addSource(px, py);
+    playerFlow.compute(costs, width, flowFieldRange);
+    playerFlowx = px;
+    playerFlowy = py;
+    playerFlowRevision = walkabilityRevision;
+  }
+  return playerFlow;
+}
+
+std::shared_ptr<const map::PathSnapshot> Dungeon::getPathSnapshot(map::PathCostPolicy policy) {
+  getCostGrid(policy);
+  if (pathSnapshot && pathSnapshot->revision == walkabilityRevision && !pathSnapshot->clusters[policy].empty()) {
+    return pathSnapshot;
+  }
+  if (!pathGraphs[policy]) pathGraphs[policy] = new map::ClusterGraph(width, height);
+  // no copy here. the grids are copied by updateWalkCost if they change while the snapshot is in use
+  auto snapshot = std::make_shared<map::PathSnapshot>();
+  snapshot->revision = walkabilityRevision;
+  snapshot->grid.init(width, height);
+  for (int i = 0; i < map::NB_PATH_COST_POLICIES; i++) {
+    snapshot->costs[i] = costGrids[i];
+    if (!pathGraphs[i]) continue;
+    pathGraphs[i]->update(costGrids[i]->data());
+    snapshot->clusters[i] = pathGraphs[i]->getClusters();
+  }
+  pathSnapshot = snapshot;
+  return pathSnapshot;
+}
+
+bool Dungeon::computePath(int ox, int oy, int dx, int dy, util::Path& path, const map::PathCost& cost) {
+  if (!pathFinder) pathFinder = new map::ClusterPathFinder();
+  std::shared_ptr<const map::PathSnapshot> snapshot = getPathSnapshot(cost.policy);
+  return pathFinder->computePath(*snapshot, ox, oy, dx, dy, path, cost);
+}
+
+std::shared_ptr<map::PathRequest> Dungeon::requestPath(int ox, int oy, int dx, int dy, map::PathCost cost) {
+  releasePathRequests();
+  auto request =
+      std::make_shared<map::PathRequest>(getPathSnapshot(cost.policy), ox, oy, dx, dy, std::move(cost));
+  threadPool->submitLowPriority([request]() { request->run(); });
+  pathRequests.push_back(request);
+  return request;
+}
+
+// isDone locks the request. the worker reads of the snapshot happen before the release
+void Dungeon::releasePathRequests() {
+  for (size_t i = 0; i < pathRequests.size();) {
+    if (pathRequests[i]->isDone()) {
+      pathRequests[i]->releaseSnapshot();
+      pathRequests[i] = std::move(pathRequests.back());
+      pathRequests.pop_back();
+    } else {
+      i++;
+    }
+  }
+}
+
+bool Dungeon::isPathValid(uint32_t revision, const util::Path& path) {
+  if (revision == walkabilityRevision) return true;
+  const float* costs = getWalkCosts();
+  for (int i = 0; i < path.size(); i++) {
+    int x, y;
+    path.get(i, &x, &y);
+    if (!IN_RECTANGLE(x, y, width, height) || costs[x + y * width] <= 0.0f) return false;
+  }
+  return true;
+}
+
+void Dungeon::getCrowdedCells(std::vector<int>* cells) const {
+  cells->clear();
+  for (mob::Creature** it = creatures.begin(); it != creatures.end(); it++) {
+    cells->push_back((int)(*it)->x_ + (int)(*it)->y_ * width);
+  }
+  cells->push_back((int)gameEngine->player.x_ + (int)gameEngine->player.y_ * width);
 }
 
 item::Item* Dungeon::removeItem(item::Item* it, int count, bool del) {
@@ -758,6 +1196,7 @@ void Dungeon::renderItems(map::LightMap& lightMap, TCODImage* ground) {
 }
 
 void Dungeon::updateItems(float elapsed, TCOD_key_t k, TCOD_mouse_t* mouse) {
+  PROFILE("updateItems");
   std::vector<item::Item*> toDelete;
   isUpdatingItems = true;
   for (item::Item* it : items) {
@@ -793,8 +1232,22 @@ bool Dungeon::hasLos(int xFrom, int yFrom, int xTo, int yTo, bool ignoreCreature
 }
 
 void Dungeon::computeFov(int x, int y) {
+  PROFILE("computeFov");
+  bool fovChanged = x != fovx || y != fovy || fovRevision != transparencyRevision;
+  // same fov and same view as last time
+  if (!fovChanged && fovOffsetx == gameEngine->xOffset && fovOffsety == gameEngine->yOffset) return;
   // compute fov on 2x map, then copy info to 1x map
-  map2x->computeFov(2 * x, 2 * y, CON_W, true, FOV_RESTRICTIVE);
+  if (fovChanged) {
+    fov2x.clear();
+    util::computeShadowcastingFov(getTransparencyGrid2x(), 2 * x, 2 * y, CON_W, true, fov2x);
+    fov1x.downsample(fov2x);
+    computeFovCoef(2 * x, 2 * y, CON_W);
+    fovx = x;
+    fovy = y;
+    fovRevision = transparencyRevision;
+  }
+  fovOffsetx = gameEngine->xOffset;
+  fovOffsety = gameEngine->yOffset;
   // dungeon rectangle corresponding to console
   int minx = gameEngine->xOffset;
   int miny = gameEngine->yOffset;
@@ -807,11 +1260,43 @@ void Dungeon::computeFov(int x, int y) {
   maxy = std::min(height - 1, maxy);
   for (int cx = minx; cx <= maxx; cx++) {
     for (int cy = miny; cy <= maxy; cy++) {
-      map->setInFov(
-          cx,
-          cy,
-          map2x->isInFov(cx * 2, cy * 2) || map2x->isInFov(cx * 2 + 1, cy * 2) || map2x->isInFov(cx * 2, cy * 2 + 1) ||
-              map2x->isInFov(cx * 2 + 1, cy * 2 + 1));
+      map->setInFov(cx, cy, fov1x.get(cx, cy));
+    }
+  }
+}
+
+// 3x3 box count of the fov cells, done in two 1D passes
+void Dungeon::computeFovCoef(int x2, int y2, int range) {
+  // the fov can't go further than range. one more cell for the neighbours,
+  // so that everything outside this rectangle is out of fov
+  fovCoefMinx = std::max(0, x2 - range - 1);
+  fovCoefMiny = std::max(0, y2 - range - 1);
+  fovCoefWidth = std::max(0, std::min(width * 2 - 1, x2 + range + 1) - fovCoefMinx + 1);
+  fovCoefHeight = std::max(0, std::min(height * 2 - 1, y2 + range + 1) - fovCoefMiny + 1);
+  fovCoef.resize(fovCoefWidth * fovCoefHeight);
+  // horizontal pass
+  std::vector<uint8_t> rowCount(fovCoefWidth * fovCoefHeight);
+  for (int y = 0; y < fovCoefHeight; y++) {
+    int dungeon2y = y + fovCoefMiny;
+    uint8_t* row = &rowCount[y * fovCoefWidth];
+    int center = 0;
+    int right = fovCoefWidth > 0 && fov2x.get(fovCoefMinx, dungeon2y) ? 1 : 0;
+    for (int x = 0; x < fovCoefWidth; x++) {
+      int left = center;
+      center = right;
+      right = x + 1 < fovCoefWidth && fov2x.get(x + 1 + fovCoefMinx, dungeon2y) ? 1 : 0;
+      row[x] = (uint8_t)(left + center + right);
+    }
+  }
+  // vertical pass. the cell itself is in fov when the coefficient is used
+  for (int y = 0; y < fovCoefHeight; y++) {
+    const uint8_t* row = &rowCount[y * fovCoefWidth];
+    const uint8_t* up = y > 0 ? row - fovCoefWidth : nullptr;
+    const uint8_t* down = y < fovCoefHeight - 1 ? row + fovCoefWidth : nullptr;
+    float* coef = &fovCoef[y * fovCoefWidth];
+    for (int x = 0; x < fovCoefWidth; x++) {
+      int count = row[x] - 1 + (up ? up[x] : 0) + (down ? down[x] : 0);
+      coef[x] = count * 0.125f;
     }
   }
 }
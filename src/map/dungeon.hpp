@@ -27,14 +27,19 @@
 
 #include <array>
 #include <libtcod.hpp>
+#include <memory>
 #include <vector>
 
 #include "base/savegame.hpp"
 #include "map/cell.hpp"
+#include "map/pathfinder.hpp"
 #include "mob/creature.hpp"
+#include "util/bitgrid.hpp"
 #include "util/cavegen.hpp"
 #include "util/cellular.hpp"
 #include "util/clouds.hpp"
+#include "util/dirtyrects.hpp"
+#include "util/flowfield.hpp"
 
 namespace mob {
 class Player;
@@ -77,6 +82,29 @@ class Dungeon : public base::SaveListener {
   void computeFov(int x, int y);
   bool hasLos(int xFrom, int yFrom, int xTo, int yTo, bool ignoreCreatures) const;
   inline bool isCellInFov(float x, float y) { return map->isInFov((int)x, (int)y); }
+  // player fov at double resolution
+  inline bool isInFov2x(int x2, int y2) const {
+    if (!IN_RECTANGLE(x2, y2, fov2x.getWidth(), fov2x.getHeight())) return false;
+    return fov2x.get(x2, y2);
+  }
+  // anti-aliasing coefficient of an in fov 2x cell : ratio of its neighbours in fov. updated with the fov
+  inline float getFovCoef2x(int x2, int y2) const {
+    x2 -= fovCoefMinx;
+    y2 -= fovCoefMiny;
+    if (x2 < 0 || y2 < 0 || x2 >= fovCoefWidth || y2 >= fovCoefHeight) return 0.0f;
+    return fovCoef[x2 + y2 * fovCoefWidth];
+  }
+  // double resolution bit grids mirroring map2x
+  const util::BitGrid& getTransparencyGrid2x();
+  const util::BitGrid& getWalkabilityGrid2x();
+  // changes each time a cell transparency changes. never the same value for two dungeons
+  inline uint32_t getTransparencyRevision() const { return transparencyRevision; }
+  // changes each time a cell walk cost changes. never the same value for two dungeons
+  inline uint32_t getWalkabilityRevision() const { return walkabilityRevision; }
+  // cost grids of the path searches, built on first use
+  const float* getCostGrid(map::PathCostPolicy policy);
+  // terrain walk cost of each cell, 0 for non walkable cells
+  inline const float* getWalkCosts() { return getCostGrid(map::PATH_COST_TERRAIN); }
 
   // creatures
   bool hasCreature(int x, int y) const;
@@ -91,16 +119,29 @@ class Dungeon : public base::SaveListener {
   void renderSubcellCreatures(map::LightMap& lightMap);
   void renderCorpses(map::LightMap& lightMap);
   void computeSpawnSources();
-  void getClosestSpawnSource(float x, float y, int* ssx, int* ssy) const {
+  void getClosestSpawnSource(float x, float y, int* ssx, int* ssy) {
     return getClosestSpawnSource((int)x, (int)y, ssx, ssy);
   }
-  auto getClosestSpawnSource(int x, int y) -> std::array<int, 2> const {
+  auto getClosestSpawnSource(int x, int y) -> std::array<int, 2> {
     std::array<int, 2> out;
     getClosestSpawnSource(x, y, &out.at(0), &out.at(1));
     return out;
   }
-  void getClosestSpawnSource(int x, int y, int* ssx, int* ssy) const;
+  // one of the closest spawn sources along the walk costs, not in the player fov
+  void getClosestSpawnSource(int x, int y, int* ssx, int* ssy);
   void updateCreatures(float elapsed);
+  // distance to the player along the walk costs, shared by the creatures chasing the player
+  const util::FlowField& getPlayerFlowField();
+  // walkability state for the path searches. rebuilt when the walkability changed since the last snapshot
+  std::shared_ptr<const map::PathSnapshot> getPathSnapshot(map::PathCostPolicy policy);
+  // hierarchical path search on the main thread
+  bool computePath(int ox, int oy, int dx, int dy, util::Path& path, const map::PathCost& cost = map::PathCost());
+  // same search on the thread pool
+  std::shared_ptr<map::PathRequest> requestPath(int ox, int oy, int dx, int dy, map::PathCost cost);
+  // a path computed for an older walkability revision is still valid if all its steps are walkable
+  bool isPathValid(uint32_t revision, const util::Path& path);
+  // cells occupied by the creatures and the player, for map::PathCost::crowdedCells
+  void getCrowdedCells(std::vector<int>* cells) const;
   void killCreaturesAtRange(int radius);
   void setPlayerStartingPosition();
 
@@ -125,8 +166,11 @@ class Dungeon : public base::SaveListener {
   // lights
   inline void setAmbient(const TCODColor& col) { ambient = col; }
   inline const TCODColor& getAmbient() { return ambient; }
-  inline void addLight(map::Light* light) { lights.push(light); }
-  inline void removeLight(map::Light* light) { lights.removeFast(light); }
+  void addLight(map::Light* light);
+  void removeLight(map::Light* light);
+  // lights in the dungeon are moved with this so that the lights index and the static light layer follow them.
+  // the range and color of a static light must not change once it is added
+  void moveLight(map::Light* light, float x, float y);
   void renderLightsToLightMap(
       map::LightMap& lightMap,
       int* minx = NULL,
@@ -151,6 +195,7 @@ class Dungeon : public base::SaveListener {
   inline float getInterpolatedCloudCoef(int x2, int y2) const {
     return clouds ? clouds->getInterpolatedThickness(x2, y2) : 1.0f;
   }
+  inline int getCloudRevision() const { return clouds ? clouds->getRevision() : 0; }
   inline float getCloudCoef(float x2, float y2) const { return getCloudCoef((int)x2, (int)y2); }
   inline float getCloudCoef(int x2, int y2) const { return clouds ? clouds->getThickness(x2, y2) : 1.0f; }
 
@@ -193,11 +238,71 @@ class Dungeon : public base::SaveListener {
  protected:
   int level;
   TCODList<int> spawnSources;
+  // spawn sources in range sorted by walk distance to spawnFieldx,spawnFieldy
+  util::FlowField spawnField;
+  std::vector<int> sortedSpawnSources;
+  int spawnFieldx = -1, spawnFieldy = -1;
+  void sortSpawnSources(int x, int y);
   std::vector<item::Item*> itemsToAdd;
   bool isUpdatingItems;
   TCODList<mob::Creature*> creaturesToAdd;
   bool isUpdatingCreatures;
   TCODColor ambient;  // ambient light
+  uint32_t transparencyRevision;
+  // player fov of the last computeFov call. skipped when nothing changed
+  int fovx = -1, fovy = -1;
+  uint32_t fovRevision = 0;
+  int fovOffsetx = 0, fovOffsety = 0;  // view used to update the 1x fov
+  util::BitGrid fov2x, fov1x;
+  // anti-aliasing coefficients, only around the player since the fov range is limited
+  std::vector<float> fovCoef;
+  int fovCoefMinx = 0, fovCoefMiny = 0, fovCoefWidth = 0, fovCoefHeight = 0;
+  void computeFovCoef(int x2, int y2, int range);
+  // built from map2x on first use, once the map generation is done
+  util::BitGrid transparent2x, walkable2x;
+  bool gridsReady = false;
+  void buildGrids();
+  void setGridProperties(int x, int y, bool transparent, bool walkable);
+  uint32_t walkabilityRevision;
+  // shared with the path snapshots. copied before being modified when a snapshot still uses them
+  std::shared_ptr<map::CostGrid> costGrids[map::NB_PATH_COST_POLICIES];
+  float getPolicyCost(int x, int y, bool walkable, map::PathCostPolicy policy) const;
+  void updateWalkCost(int x, int y, bool walkable);
+  // recomputed when the player changes cell or the walk costs change
+  util::FlowField playerFlow;
+  int playerFlowx = -1, playerFlowy = -1;
+  uint32_t playerFlowRevision = 0;
+  // path searches data, created on first use. one abstract graph per cost policy
+  map::ClusterGraph* pathGraphs[map::NB_PATH_COST_POLICIES] = {};
+  std::shared_ptr<const map::PathSnapshot> pathSnapshot;
+  // every submitted request until it is done, so that its snapshot is released on the main thread
+  std::vector<std::shared_ptr<map::PathRequest>> pathRequests;
+  void releasePathRequests();
+  map::ClusterPathFinder* pathFinder = nullptr;  // for the searches on the main thread
+
+  // static lights contributions, dungeon size, 2x resolution. lights are not limited to the player fov here
+  map::LightMap* staticLightLayer = nullptr;
+  util::DirtyRects staticLightsDirty{0, 0};  // parts of the layer to bake again
+  util::DirtyRects transparencyDirty{0, 0};  // 2x cells whose transparency changed since the last bake
+  uint32_t staticLightsRevision = 0;  // transparency revision when the static lights were baked
+  int nbBakedLights = 0;
+  void updateStaticLightLayer();
+
+  std::vector<map::Light*> changedLights;  // lights added or moved since the last bake
+
+  // lights spatial index. buckets of LIGHT_BUCKET_SIZE x LIGHT_BUCKET_SIZE 2x cells.
+  // dynamic lights move every frame and are always checked
+  static constexpr int LIGHT_BUCKET_SIZE = 32;
+  std::vector<std::vector<map::Light*>> lightBuckets;
+  int lightBucketsWidth = 0, lightBucketsHeight = 0;
+  std::vector<map::Light*> dynamicLights;
+  float maxIndexedLightRange = 0.0f;  // largest range of the lights in the buckets
+  std::vector<map::Light*> visibleLights;  // result of collectVisibleLights
+  int getLightBucket(const map::Light* light) const;
+  void indexLight(map::Light* light);
+  void unindexLight(map::Light* light);
+  void clearLightIndex();
+  void collectVisibleLights(int minx2x, int miny2x, int maxx2x, int maxy2x);
   util::CloudBox* clouds = nullptr;  // for outdoors
 
   void initData(util::CaveGenerator* caveGen);
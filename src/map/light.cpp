@@ -28,31 +28,73 @@
 #include <math.h>
 
 #include "main.hpp"
+#include "map/dungeon.hpp"
 #include "map/lightmap.hpp"
 
 namespace map {
 void Light::addToLightMap(map::LightMap& lightmap) { add(&lightmap, nullptr); }
 void Light::addToImage(TCODImage& img) { add(nullptr, &img); }
 
+// part of the dungeon that the light can reach
+void Light::getArea(map::Dungeon* dungeon, int* minx, int* miny, int* w, int* h) const {
+  int lx = (int)x_;
+  int ly = (int)y_;
+  int irange = (int)range;
+  *minx = std::max(0, lx - irange);
+  *miny = std::max(0, ly - irange);
+  *w = std::min(dungeon->width * 2 - 1, lx + irange) - *minx + 1;
+  *h = std::min(dungeon->height * 2 - 1, ly + irange) - *miny + 1;
+}
+
+// compute the light fov if it's not in the cache
+void Light::updateFov(map::Dungeon* dungeon) {
+  int lx = (int)x_;
+  int ly = (int)y_;
+  int irange = (int)range;
+  if (fovRevision == dungeon->getTransparencyRevision() && lx == fovx && ly == fovy && irange == fovRange) return;
+  fovx = lx;
+  fovy = ly;
+  fovRange = irange;
+  fovRevision = dungeon->getTransparencyRevision();
+  getArea(dungeon, &fovMinx, &fovMiny, &fovWidth, &fovHeight);
+  if (fovWidth <= 0 || fovHeight <= 0) {
+    fovMask.resize(0, 0);
+    return;
+  }
+  // calculate light fov directly on the dungeon transparency
+  fovMask.resize(fovWidth, fovHeight);
+  util::computeShadowcastingFov(dungeon->getTransparencyGrid2x(), lx, ly, irange, true, fovMask, fovMinx, fovMiny);
+}
+
 void Light::add(map::LightMap* l, TCODImage* img) {
+  static float lodRange = 2 * config.getFloatProperty("config.display.lightLodRange");
   if (this->range == 0.0f) return;
-  // get light range in dungeon coordinates
-  int minx = (int)(this->x_ - this->range);
-  int maxx = (int)(this->x_ + this->range);
-  int miny = (int)(this->y_ - this->range);
-  int maxy = (int)(this->y_ + this->range);
+  map::Dungeon* dungeon = gameEngine->dungeon;
+  // level of detail : small lights and moving lights out of the player fov are splatted without shadows
+  bool shadows = range >= lodRange;
+  int lx = (int)x_;
+  int ly = (int)y_;
+  if (shadows && dynamic && IN_RECTANGLE(lx, ly, dungeon->width * 2, dungeon->height * 2)) {
+    shadows = dungeon->isInFov2x(lx, ly);
+  }
+  int areaMinx, areaMiny, areaWidth, areaHeight;
+  if (shadows) {
+    updateFov(dungeon);
+    if (fovMask.isEmpty()) return;
+    areaMinx = fovMinx;
+    areaMiny = fovMiny;
+    areaWidth = fovWidth;
+    areaHeight = fovHeight;
+  } else {
+    getArea(dungeon, &areaMinx, &areaMiny, &areaWidth, &areaHeight);
+  }
   int xOffset = gameEngine->xOffset * 2;
   int yOffset = gameEngine->yOffset * 2;
-  // clamp it to the dungeon
-  minx = std::max(0, minx);
-  miny = std::max(0, miny);
-  maxx = std::min(gameEngine->dungeon->width * 2 - 1, maxx);
-  maxy = std::min(gameEngine->dungeon->height * 2 - 1, maxy);
-  // convert it to lightmap (console x2) coordinates
-  minx -= xOffset;
-  maxx -= xOffset;
-  miny -= yOffset;
-  maxy -= yOffset;
+  // convert the light area to lightmap (console x2) coordinates
+  int minx = areaMinx - xOffset;
+  int miny = areaMiny - yOffset;
+  int maxx = minx + areaWidth - 1;
+  int maxy = miny + areaHeight - 1;
   // clamp it to the lightmap
   minx = std::max(0, minx);
   miny = std::max(0, miny);
@@ -66,73 +108,36 @@ void Light::add(map::LightMap* l, TCODImage* img) {
     maxy = std::min(ih - 1, maxy);
   }
 
-  int fovmap_width = maxx - minx;
-  int fovmap_height = maxy - miny;
+  int fovmap_width = maxx - minx + 1;
+  int fovmap_height = maxy - miny + 1;
 
   // watch out ! 3 different coordinates referentials here
   // dungeon (xOffset, yOffset, this->x, this->y)
   // lightmap (minx,maxx,miny,maxy)
-  // fovmap : subpart of lightmap to compute light fov
+  // fov mask : part of the dungeon reached by the light (fovMinx, fovMiny)
 
   if (fovmap_width <= 0 || fovmap_height <= 0) return;
-  // create a small map for the light fov
-  TCODMap fovmap(fovmap_width, fovmap_height);
-  // copy dungeon info into it
-  for (int cx = 0; cx < fovmap_width; cx++) {
-    for (int cy = 0; cy < fovmap_height; cy++) {
-      int dungeon2x = cx + minx + xOffset;
-      int dungeon2y = cy + miny + yOffset;
-      bool canpass = gameEngine->dungeon->map2x->isTransparent(dungeon2x, dungeon2y);
-      fovmap.setProperties(cx, cy, canpass, canpass);
-    }
-  }
-  // calculate light fov
-  // the fov algo must support viewer out of the map !
-  fovmap.computeFov((int)(this->x_ - xOffset - minx), (int)(this->y_ - yOffset - miny), (int)(range), true, FOV_BASIC);
+  int maskx = minx + xOffset - fovMinx;
+  int masky = miny + yOffset - fovMiny;
 
   float squaredRange = range * range;
-  TCODMap* map2x = gameEngine->dungeon->map2x;
+  if (randomRad) computeRadiusTable(squaredRange);
   // get fov data and add light to lightmap
   for (int cx = 0; cx < fovmap_width; cx++) {
     for (int cy = 0; cy < fovmap_height; cy++) {
-      if (fovmap.isInFov(cx, cy)) {
+      if (!shadows || fovMask.get(cx + maskx, cy + masky)) {
         int dungeon2x = cx + minx + xOffset;
         int dungeon2y = cy + miny + yOffset;
-        if (map2x->isInFov(dungeon2x, dungeon2y)) {
-          int dx = (int)(dungeon2x - this->x_);
-          int dy = (int)(dungeon2y - this->y_);
-          float crange = dx * dx + dy * dy;
-          float coef;
-          float rad = 0.0f;
-          if (randomRad) {
-            float angle = atan2f(dy, dx);
-            float f = angle + noise_offset_;
-            float squaredRangeRnd = squaredRange * (0.5f * (1.0f + noise1d.get(&f)));
-            // fix radius continuity near -PI
-            float rcoef = 0.0f;
-            if (angle < -7 * M_PI / 8) rcoef = (-7 * M_PI / 8 - angle) / (M_PI / 8);
-            if (rcoef > 1E-6f) {
-              float fpi = M_PI + noise_offset_;
-              float squaredRangePi = squaredRange * (0.5f * (1.0f + noise1d.get(&fpi)));
-              squaredRangeRnd = squaredRangeRnd + rcoef * (squaredRangePi - squaredRangeRnd);
-            }
-            rad = crange / squaredRangeRnd;
-            rad = std::min(1.0f, rad);
-            coef = 1.0f - rad;
-          } else {
-            rad = crange / squaredRange;
-            rad = std::min(1.0f, rad);
-            coef = 1.0f - rad;
-          }
+        if (dungeon->isInFov2x(dungeon2x, dungeon2y)) {
+          float rad;
+          float coef = getCoef(dungeon2x, dungeon2y, squaredRange, &rad);
           if (coef > 0.0f) {
             map::HDRColor col = getColor(rad);
 
             float intensity = getIntensity();
             coef *= intensity;
             if (l) {
-              map::HDRColor prevCol = l->getHdrColor2x(cx + minx, cy + miny);
-              prevCol = prevCol + (col * coef);
-              l->setColor2x(cx + minx, cy + miny, prevCol);
+              l->addColor2x(cx + minx, cy + miny, col * coef);
             } else {
               map::HDRColor prevCol = img->getPixel(cx + minx, cy + miny);
               prevCol = prevCol + (col * coef);
@@ -145,6 +150,101 @@ void Light::add(map::LightMap* l, TCODImage* img) {
   }
 }
 
+// random radius lights : number of angle steps in the radius table
+static const int ANGLE_BINS = 256;
+// offsets for which the angle step is precomputed
+static const int ANGLE_LUT_RANGE = 64;
+static const int ANGLE_LUT_SIZE = 2 * ANGLE_LUT_RANGE + 1;
+
+static int computeAngleBin(float angle) {
+  int bin = (int)((angle + M_PI) * ANGLE_BINS / (2 * M_PI));
+  return std::clamp(bin, 0, ANGLE_BINS - 1);
+}
+
+// angle step of a light to cell offset, without atan2
+static int getAngleBin(int dx, int dy) {
+  static const std::vector<uint8_t> lut = []() {
+    std::vector<uint8_t> ret(ANGLE_LUT_SIZE * ANGLE_LUT_SIZE);
+    for (int y = 0; y < ANGLE_LUT_SIZE; y++) {
+      for (int x = 0; x < ANGLE_LUT_SIZE; x++) {
+        ret[x + y * ANGLE_LUT_SIZE] =
+            (uint8_t)computeAngleBin(atan2f(y - ANGLE_LUT_RANGE, x - ANGLE_LUT_RANGE));
+      }
+    }
+    return ret;
+  }();
+  if (dx < -ANGLE_LUT_RANGE || dx > ANGLE_LUT_RANGE || dy < -ANGLE_LUT_RANGE || dy > ANGLE_LUT_RANGE) {
+    return computeAngleBin(atan2f(dy, dx));
+  }
+  return lut[dx + ANGLE_LUT_RANGE + (dy + ANGLE_LUT_RANGE) * ANGLE_LUT_SIZE];
+}
+
+// noisy squared radius of a random radius light for each angle step.
+// only depends on the range since the noise offset never changes
+void Light::computeRadiusTable(float squaredRange) {
+  if (squaredRange == radiusTableRange && !squaredRadii.empty()) return;
+  radiusTableRange = squaredRange;
+  squaredRadii.resize(ANGLE_BINS);
+  for (int i = 0; i < ANGLE_BINS; i++) {
+    float angle = -M_PI + (i + 0.5f) * 2 * M_PI / ANGLE_BINS;
+    float f = angle + noise_offset_;
+    float squaredRangeRnd = squaredRange * (0.5f * (1.0f + noise1d.get(&f)));
+    // fix radius continuity near -PI
+    float rcoef = 0.0f;
+    if (angle < -7 * M_PI / 8) rcoef = (-7 * M_PI / 8 - angle) / (M_PI / 8);
+    if (rcoef > 1E-6f) {
+      float fpi = M_PI + noise_offset_;
+      float squaredRangePi = squaredRange * (0.5f * (1.0f + noise1d.get(&fpi)));
+      squaredRangeRnd = squaredRangeRnd + rcoef * (squaredRangePi - squaredRangeRnd);
+    }
+    squaredRadii[i] = squaredRangeRnd;
+  }
+}
+
+// light coefficient at a dungeon 2x position, before intensity. rad is the relative distance to the light
+// random radius lights need computeRadiusTable first
+float Light::getCoef(int dungeon2x, int dungeon2y, float squaredRange, float* rad) {
+  int dx = (int)(dungeon2x - this->x_);
+  int dy = (int)(dungeon2y - this->y_);
+  float crange = dx * dx + dy * dy;
+  if (randomRad) {
+    *rad = crange / squaredRadii[getAngleBin(dx, dy)];
+  } else {
+    *rad = crange / squaredRange;
+  }
+  *rad = std::min(1.0f, *rad);
+  return 1.0f - *rad;
+}
+
+void Light::addToLayer(map::Dungeon* dungeon, map::LightMap* layer, const base::Rect& clip) {
+  bakedx = x_;
+  bakedy = y_;
+  bakedRange = range;
+  bakedColor = color;
+  if (range == 0.0f) return;
+  updateFov(dungeon);
+  if (fovMask.isEmpty()) return;
+  float squaredRange = range * range;
+  if (randomRad) computeRadiusTable(squaredRange);
+  float intensity = getIntensity();
+  int minx = std::max(0, (int)clip.x_ - fovMinx);
+  int miny = std::max(0, (int)clip.y_ - fovMiny);
+  int maxx = std::min(fovWidth, (int)clip.x_ + clip.w_ - fovMinx);
+  int maxy = std::min(fovHeight, (int)clip.y_ + clip.h_ - fovMiny);
+  for (int cy = miny; cy < maxy; cy++) {
+    for (int cx = minx; cx < maxx; cx++) {
+      if (!fovMask.get(cx, cy)) continue;
+      int dungeon2x = cx + fovMinx;
+      int dungeon2y = cy + fovMiny;
+      float rad;
+      float coef = getCoef(dungeon2x, dungeon2y, squaredRange, &rad);
+      if (coef > 0.0f) {
+        layer->addColor2x(dungeon2x, dungeon2y, getColor(rad) * (coef * intensity));
+      }
+    }
+  }
+}
+
 // part of the dungeon that this light can hit (2x coords)
 void Light::getDungeonPart(int* minx, int* miny, int* maxx, int* maxy) {
   *minx = (int)(x_ - range);
@@ -25,12 +25,16 @@
  */
 #pragma once
 #include <libtcod.hpp>
+#include <vector>
 
 #include "base/entity.hpp"
 #include "base/noisything.hpp"
 #include "map/lightmap.hpp"
+#include "util/bitgrid.hpp"
 
 namespace map {
+class Dungeon;
+
 class Light : public base::Entity, public base::NoisyThing {
  public:
   Light() : randomRad(false), range(0.0f), color{tcod::ColorRGB{255, 255, 255}} {}
@@ -41,15 +45,55 @@ class Light : public base::Entity, public base::NoisyThing {
   void getDungeonPart(int* minx, int* miny, int* maxx, int* maxy);
   virtual void update([[maybe_unused]] float elapsed) {}
 
+  // static lights are baked once in the dungeon static light layer
+  virtual bool isStatic() const { return !dynamic; }
+  // add the part of the light inside clip to a dungeon sized 2x layer, ignoring the player fov
+  void addToLayer(map::Dungeon* dungeon, map::LightMap* layer, const base::Rect& clip);
+  inline bool hasChangedSinceBake() const {
+    return x_ != bakedx || y_ != bakedy || range != bakedRange || color != bakedColor;
+  }
+  // 2x dungeon area the light can hit now, and when it was baked
+  inline base::Rect getLitArea() const { return getArea(x_, y_, range); }
+  inline base::Rect getBakedArea() const { return getArea(bakedx, bakedy, bakedRange); }
+  // the transparency changes since oldRevision are out of the light area. the fov cache is still valid
+  inline void keepFov(uint32_t oldRevision, uint32_t newRevision) {
+    if (fovRevision == oldRevision) fovRevision = newRevision;
+  }
+
   bool randomRad;
   float range;
   map::HDRColor color;
+  bool dynamic = false;  // moves (carried torch, fireball...). never baked
+  bool baked = false;  // currently in the static light layer
+  int lightBucket = -1;  // bucket in the dungeon lights index. -1 for dynamic lights and lights out of the dungeon
 
  protected:
   void add(map::LightMap* l, TCODImage* i);
+  void getArea(map::Dungeon* dungeon, int* minx, int* miny, int* w, int* h) const;
+  static inline base::Rect getArea(float x, float y, float range) {
+    int irange = (int)range;
+    return base::Rect((int)x - irange, (int)y - irange, 2 * irange + 1, 2 * irange + 1);
+  }
+  void updateFov(map::Dungeon* dungeon);
+  float getCoef(int dungeon2x, int dungeon2y, float squaredRange, float* rad);
+  void computeRadiusTable(float squaredRange);
   virtual float getIntensity() { return 1.0f; }
   virtual map::HDRColor getColor([[maybe_unused]] float rad) { return color; }
   float getFog(int x, int y);
+
+  // fov cache, in dungeon 2x coordinates.
+  // valid while the light integer position, range and the dungeon transparency don't change
+  util::BitGrid fovMask;
+  int fovMinx = 0, fovMiny = 0, fovWidth = 0, fovHeight = 0;
+  int fovx = 0, fovy = 0, fovRange = 0;
+  uint32_t fovRevision = 0;
+
+  std::vector<float> squaredRadii;  // random radius for each angle step
+  float radiusTableRange = 0.0f;  // squared range used for squaredRadii
+
+  // state of the light when it was baked
+  float bakedx = 0.0f, bakedy = 0.0f, bakedRange = 0.0f;
+  map::HDRColor bakedColor;
 };
 
 class ExtendedLight : public Light {
@@ -57,14 +101,16 @@ class ExtendedLight : public Light {
   void setup(
       map::HDRColor outColor, float intensityPatternDelay, const char* intensityPattern, const char* colorPattern);
   void update(float elapsed) override;
+  // flickering lights can't be baked
+  bool isStatic() const override { return !dynamic && intensityPatternLen == 0; }
 
  protected:
   map::HDRColor outColor;
   const char* intensityPattern = nullptr;
   const char* colorPattern = nullptr;
   float intensityPatternDelay;
-  int intensityPatternLen;
-  int colorPatternLen;
+  int intensityPatternLen = 0;
+  int colorPatternLen = 0;
   float intensityTimer;
   bool noiseIntensity;
 
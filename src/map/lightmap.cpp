@@ -25,15 +25,145 @@
  */
 #include "map/lightmap.hpp"
 
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "main.hpp"
 #include "map/dungeon.hpp"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHTMAP_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace map {
 HDRColor operator*(float value, const HDRColor& c) { return c * value; }
 
+// row kernels. SSE2 is always available on x86_64. plain C version for the other architectures and the remainders
+
+static void fillRow(float* dst, int count, float value) {
+  int i = 0;
+#ifdef LIGHTMAP_SSE2
+  __m128 v = _mm_set1_ps(value);
+  for (; i + 4 <= count; i += 4) _mm_storeu_ps(dst + i, v);
+#endif
+  for (; i < count; i++) dst[i] = value;
+}
+
+// dst += src * mask
+static void addMaskedRow(float* dst, const float* src, const float* mask, int count) {
+  int i = 0;
+#ifdef LIGHTMAP_SSE2
+  for (; i + 4 <= count; i += 4) {
+    __m128 add = _mm_mul_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(mask + i));
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), add));
+  }
+#endif
+  for (; i < count; i++) dst[i] += src[i] * mask[i];
+}
+
+// tonemapping table. converts the HDR light values to integer values where 255 is full light.
+// with the default exposure and gamma it's the same as truncating the float values.
+// the table covers the usual light values. brighter ones are converted one by one
+static const int TONEMAP_SIZE = 1024;
+// any brighter light saturates every non black ground
+static const int MAX_TONEMAPPED_LIGHT = 255 * 255;
+
+static uint16_t toneMapValue(float light) {
+  static float exposure = config.getFloatProperty("config.display.lightExposure");
+  static float gamma = config.getFloatProperty("config.display.lightGamma");
+  float v = light * exposure;
+  if (gamma != 1.0f) v = 255.0f * powf(v / 255.0f, 1.0f / gamma);
+  return (uint16_t)std::clamp((int)std::min(v, (float)MAX_TONEMAPPED_LIGHT), 0, MAX_TONEMAPPED_LIGHT);
+}
+
+static std::vector<uint16_t> buildToneMap() {
+  std::vector<uint16_t> toneMap(TONEMAP_SIZE);
+  for (int i = 0; i < TONEMAP_SIZE; i++) toneMap[i] = toneMapValue((float)i);
+  return toneMap;
+}
+
+static const uint16_t* getToneMap() {
+  static std::vector<uint16_t> toneMap = buildToneMap();
+  return toneMap.data();
+}
+
+static inline uint16_t toneMapPixel(const uint16_t* toneMap, float light) {
+  if (light < TONEMAP_SIZE) return toneMap[std::max(0, (int)light)];
+  return toneMapValue(light);
+}
+
+// dst = tonemap(src)
+static void tonemapRow(const float* src, uint16_t* dst, int count) {
+  const uint16_t* toneMap = getToneMap();
+  int i = 0;
+#ifdef LIGHTMAP_SSE2
+  __m128 vmin = _mm_setzero_ps();
+  __m128 vsize = _mm_set1_ps((float)TONEMAP_SIZE);
+  alignas(16) int32_t idx[4];
+  for (; i + 4 <= count; i += 4) {
+    __m128 v = _mm_loadu_ps(src + i);
+    if (_mm_movemask_ps(_mm_cmpge_ps(v, vsize)) != 0) {
+      // beyond the table
+      for (int j = i; j < i + 4; j++) dst[j] = toneMapPixel(toneMap, src[j]);
+      continue;
+    }
+    _mm_store_si128((__m128i*)idx, _mm_cvttps_epi32(_mm_max_ps(v, vmin)));
+    dst[i] = toneMap[idx[0]];
+    dst[i + 1] = toneMap[idx[1]];
+    dst[i + 2] = toneMap[idx[2]];
+    dst[i + 3] = toneMap[idx[3]];
+  }
+#endif
+  for (; i < count; i++) dst[i] = toneMapPixel(toneMap, src[i]);
+}
+
+// dst = ground * light / 255 * coef / 256. light in 0-255, coef in 0-256.
+// same result as TCODColor * TCODColor * float when coef is a multiple of 1/256
+static void shadeRow(const uint16_t* ground, const uint16_t* light, const uint16_t* coef, uint8_t* dst, int count) {
+  int i = 0;
+#ifdef LIGHTMAP_SSE2
+  for (; i + 8 <= count; i += 8) {
+    __m128i x =
+        _mm_mullo_epi16(_mm_loadu_si128((const __m128i*)(ground + i)), _mm_loadu_si128((const __m128i*)(light + i)));
+    // exact x / 255 for x <= 255 * 255
+    x = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+    x = _mm_srli_epi16(_mm_mullo_epi16(x, _mm_loadu_si128((const __m128i*)(coef + i))), 8);
+    _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(x, x));
+  }
+#endif
+  for (; i < count; i++) dst[i] = (uint8_t)((ground[i] * light[i] / 255 * coef[i]) >> 8);
+}
+
+// dst = clamp(ground * light / 255, 0, 255). light can go beyond 255
+static void shadeRowHdr(const uint16_t* ground, const uint16_t* light, uint8_t* dst, int count) {
+  int i = 0;
+#ifdef LIGHTMAP_SSE2
+  __m128 vcoef = _mm_set1_ps(1.0f / 255.0f);
+  for (; i + 8 <= count; i += 8) {
+    __m128i vg = _mm_loadu_si128((const __m128i*)(ground + i));
+    __m128i vl = _mm_loadu_si128((const __m128i*)(light + i));
+    // unsigned 32 bits products. light goes up to 255 * 255
+    __m128i plo = _mm_mullo_epi16(vg, vl);
+    __m128i phi = _mm_mulhi_epu16(vg, vl);
+    __m128i lo = _mm_unpacklo_epi16(plo, phi);
+    __m128i hi = _mm_unpackhi_epi16(plo, phi);
+    lo = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), vcoef));
+    hi = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), vcoef));
+    // saturating packs : int32 -> int16 -> uint8
+    __m128i packed = _mm_packs_epi32(lo, hi);
+    _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(packed, packed));
+  }
+#endif
+  for (; i < count; i++) dst[i] = (uint8_t)std::min(255, ground[i] * light[i] / 255);
+}
+
 LightMap::LightMap(int width, int height) : width(width), height(height) {
-  data = new HDRColor[width * height / 4];
-  data2x = new HDRColor[width * height];
+  r.resize(width * height);
+  g.resize(width * height);
+  b.resize(width * height);
+  memoryMarks.resize(width * height / 4);
   // initialise fog
   fogNoise = new TCODNoise(3);
   fogZ = 0.0f;
@@ -41,34 +171,147 @@ LightMap::LightMap(int width, int height) : width(width), height(height) {
 }
 
 void LightMap::clear(const TCODColor& col) {
-  for (int x = 0; x < width; x++) {
-    for (int y = 0; y < height; y++) {
-      setColor2x(x, y, col);
-    }
+  fillRow(r.data(), width * height, col.r);
+  fillRow(g.data(), width * height, col.g);
+  fillRow(b.data(), width * height, col.b);
+}
+
+void LightMap::clear(const TCODColor& col, int x, int y, int w, int h) {
+  for (int cy = y; cy < y + h; cy++) {
+    int off = x + cy * width;
+    fillRow(r.data() + off, w, col.r);
+    fillRow(g.data() + off, w, col.g);
+    fillRow(b.data() + off, w, col.b);
   }
 }
 
+void LightMap::copy(const LightMap& src) {
+  r = src.r;
+  g = src.g;
+  b = src.b;
+}
+
+static void scrollPlane(std::vector<float>& plane, int width, int height, int dx, int dy) {
+  int count = width - abs(dx);
+  int dstx = std::max(0, -dx);
+  int miny = std::max(0, -dy);
+  int maxy = std::min(height, height - dy);
+  // rows order such that a source row is never overwritten before being read
+  for (int i = miny; i < maxy; i++) {
+    int y = dy > 0 ? i : miny + maxy - 1 - i;
+    memmove(&plane[dstx + y * width], &plane[dstx + dx + (y + dy) * width], count * sizeof(float));
+  }
+}
+
+void LightMap::scroll(int dx, int dy) {
+  if (abs(dx) >= width || abs(dy) >= height) return;
+  scrollPlane(r, width, height, dx, dy);
+  scrollPlane(g, width, height, dx, dy);
+  scrollPlane(b, width, height, dx, dy);
+}
+
+void LightMap::addRow2x(int x, int y, const LightMap& src, int srcx, int srcy, int count, const float* mask) {
+  int off = x + y * width;
+  int srcOff = srcx + srcy * src.width;
+  addMaskedRow(&r[off], &src.r[srcOff], mask, count);
+  addMaskedRow(&g[off], &src.g[srcOff], mask, count);
+  addMaskedRow(&b[off], &src.b[srcOff], mask, count);
+}
+
 void LightMap::update(float elapsed) {
   static float fogSpeed = config.getFloatProperty("config.fog.speed");
 
   fogZ += elapsed * fogSpeed;
 }
 
-float LightMap::getFog(int x, int y) {
-  static float fogMaxLevel = config.getFloatProperty("config.fog.maxLevel");
+// fog noise space coordinates of a 2x pixel
+static void getFogCoefs(float* coefx, float* coefy) {
   static float fogScale = config.getFloatProperty("config.fog.scale");
+  *coefx = fogScale / CON_W;
+  *coefy = fogScale / CON_H;
+}
+
+// fog grid resolution in 2x pixels
+static const int FOG_STEP = 8;
+
+float LightMap::getFogNoise(float fx, float fy, float fz) {
+  static float fogMaxLevel = config.getFloatProperty("config.fog.maxLevel");
   static float fogOctaves = config.getFloatProperty("config.fog.octaves");
-  static float coefx = fogScale / CON_W;
-  static float coefy = fogScale / CON_H;
 
-  float f[3] = {x * coefx, y * coefy, fogZ};
+  float f[3] = {fx, fy, fz};
   return fogMaxLevel * 0.5f * (fogNoise->getFbm(f, fogOctaves) + 1.0f);
 }
 
+float LightMap::getFog(int x, int y) {
+  float coefx, coefy;
+  getFogCoefs(&coefx, &coefy);
+  return getFogNoise(x * coefx, y * coefy, fogZ);
+}
+
+void LightMap::computeFogSlice(std::vector<float>& grid, int slice) {
+  float coefx, coefy;
+  getFogCoefs(&coefx, &coefy);
+  int gridw = width / FOG_STEP + 2;
+  int gridh = height / FOG_STEP + 2;
+  // same resolution along z as along x
+  float fz = slice * FOG_STEP * coefx;
+  grid.resize(gridw * gridh);
+  for (int gy = 0; gy < gridh; gy++) {
+    for (int gx = 0; gx < gridw; gx++) {
+      grid[gx + gy * gridw] =
+          getFogNoise((fogGridx + gx * FOG_STEP) * coefx, (fogGridy + gy * FOG_STEP) * coefy, fz);
+    }
+  }
+}
+
+void LightMap::updateFogGrid(int originx, int originy) {
+  float coefx, coefy;
+  getFogCoefs(&coefx, &coefy);
+  float sliceLength = FOG_STEP * coefx;
+  int slice = (int)floorf(fogZ / sliceLength);
+  fogSliceCoef = fogZ / sliceLength - slice;
+  if (!fogGrid[0].empty() && originx == fogGridx && originy == fogGridy) {
+    if (slice == fogSlice) return;
+    if (slice == fogSlice + 1) {
+      // the fog moved to the next slice
+      std::swap(fogGrid[0], fogGrid[1]);
+      computeFogSlice(fogGrid[1], slice + 1);
+      fogSlice = slice;
+      return;
+    }
+  }
+  fogGridx = originx;
+  fogGridy = originy;
+  fogSlice = slice;
+  computeFogSlice(fogGrid[0], slice);
+  computeFogSlice(fogGrid[1], slice + 1);
+}
+
+// trilinear interpolation of the fog grid
+float LightMap::getGridFog(int x, int y) {
+  if (fogGrid[0].empty()) return getFog(x, y);
+  int gridw = width / FOG_STEP + 2;
+  int gridh = height / FOG_STEP + 2;
+  float fx = (float)(x - fogGridx) / FOG_STEP;
+  float fy = (float)(y - fogGridy) / FOG_STEP;
+  int ix = std::clamp((int)floorf(fx), 0, gridw - 2);
+  int iy = std::clamp((int)floorf(fy), 0, gridh - 2);
+  float dx = std::clamp(fx - ix, 0.0f, 1.0f);
+  float dy = std::clamp(fy - iy, 0.0f, 1.0f);
+  float fog[2];
+  for (int i = 0; i < 2; i++) {
+    const float* grid = &fogGrid[i][ix + iy * gridw];
+    float top = grid[0] + dx * (grid[1] - grid[0]);
+    float bottom = grid[gridw] + dx * (grid[gridw + 1] - grid[gridw]);
+    fog[i] = top + dy * (bottom - top);
+  }
+  return fog[0] + fogSliceCoef * (fog[1] - fog[0]);
+}
+
 float LightMap::getPlayerFog(int x, int y) {
   if (fogRange == 0.0f) return 0.0f;
   float maxDistDiv = 1.0f / (fogRange * fogRange);
-  float fogLevel = gameEngine->getFog(x, y);  // amount of fog, between 0 and fogMaxLevel
+  float fogLevel = getGridFog(x, y);  // amount of fog, between 0 and fogMaxLevel
   float playerdx = gameEngine->player.x_ * 2 - x;
   float playerdy = gameEngine->player.y_ * 2 - y;
   float fogDist = playerdx * playerdx + playerdy * playerdy;  // distance from player
@@ -78,8 +321,12 @@ float LightMap::getPlayerFog(int x, int y) {
   return fogLevel;
 }
 
+// number of console cell rows processed by a thread pool task
+static const int BAND_HEIGHT = 4;
+
 // apply a light map to an image.
 void LightMap::applyToImage(TCODImage& image, int minx2x, int miny2x, int maxx2x, int maxy2x, bool playerFog) {
+  PROFILE("applyToImage");
   static TCODColor fogColor = config.getColorProperty("config.fog.col");
   static TCODColor memoryWallColor = config.getColorProperty("config.display.memoryWallColor");
   static int memoryWallIntensity = (int)(memoryWallColor.r) + memoryWallColor.g + memoryWallColor.b;
@@ -88,74 +335,139 @@ void LightMap::applyToImage(TCODImage& image, int minx2x, int miny2x, int maxx2x
   map::Dungeon* dungeon = gameEngine->dungeon;
   if (maxx2x == 0) maxx2x = width - 1;
   if (maxy2x == 0) maxy2x = height - 1;
-  for (int x = minx2x; x <= maxx2x; x++) {
-    for (int y = miny2x; y < maxy2x; y++) {
-      int dungeonx = x + gameEngine->xOffset * 2;
-      int dungeony = y + gameEngine->yOffset * 2;
-      if (!IN_RECTANGLE(dungeonx, dungeony, dungeon->width * 2, dungeon->height * 2)) {
-        image.putPixel(x, y, TCODColor::black);  // out of the map
-      } else {
+  int offx2x = gameEngine->xOffset * 2;
+  int offy2x = gameEngine->yOffset * 2;
+  // must be done before the bands read it
+  if (playerFog && fogRange > 0.0f) updateFogGrid(offx2x, offy2x);
+  uint8_t fogr = fogColor.r, fogg = fogColor.g, fogb = fogColor.b;
+  // one band = rows [from*2, to*2[
+  auto shadeBand = [&](int from, int to) {
+    int count = maxx2x - minx2x + 1;
+    std::vector<uint16_t> lightr(count), lightg(count), lightb(count);
+    std::vector<uint16_t> groundr(count), groundg(count), groundb(count), coefs(count);
+    std::vector<uint8_t> outr(count), outg(count), outb(count);
+    int bandMaxy = std::min(maxy2x + 1, to * 2);
+    for (int y = std::max(miny2x, from * 2); y < bandMaxy; y++) {
+      int off = minx2x + y * width;
+      tonemapRow(&r[off], lightr.data(), count);
+      tonemapRow(&g[off], lightg.data(), count);
+      tonemapRow(&b[off], lightb.data(), count);
+      for (int i = 0; i < count; i++) {
+        int x = i + minx2x;
+        int dungeonx = x + offx2x;
+        int dungeony = y + offy2x;
+        if (!IN_RECTANGLE(dungeonx, dungeony, dungeon->width * 2, dungeon->height * 2)) {
+          coefs[i] = 0;  // out of the map
+          continue;
+        }
         // visible cell. shade it
         TCODColor col = dungeon->getGroundColor(dungeonx, dungeony);  // wall?wallColor:groundColor;
-        TCODColor lmcol = playerFog ? TCODColor::lerp(data2x[x + y * width], fogColor, getPlayerFog(dungeonx, dungeony))
-                                    : (TCODColor)data2x[x + y * width];
-
-        int lightIntensity = (int)(lmcol.r) + lmcol.g + lmcol.b;
-        float coef = 1.0f;
+        int lr = std::min<int>(lightr[i], 255);
+        int lg = std::min<int>(lightg[i], 255);
+        int lb = std::min<int>(lightb[i], 255);
+        if (playerFog) {
+          // fixed point lerp with the fog color
+          int fog = std::clamp((int)(getPlayerFog(dungeonx, dungeony) * 256), 0, 256);
+          lr = (lr * (256 - fog) + fogr * fog) >> 8;
+          lg = (lg * (256 - fog) + fogg * fog) >> 8;
+          lb = (lb * (256 - fog) + fogb * fog) >> 8;
+        }
+        int lightIntensity = lr + lg + lb;
+        int coef = 256;
 
-        if (!dungeon->map2x->isInFov(dungeonx, dungeony) || lightIntensity < memoryWallIntensity) {
+        if (!dungeon->isInFov2x(dungeonx, dungeony) || lightIntensity < memoryWallIntensity) {
           if (dungeon->getMemory(dungeonx / 2, dungeony / 2) && !dungeon->map2x->isTransparent(dungeonx, dungeony)) {
-            lmcol = memoryWallColor;
+            lr = memoryWallColor.r;
+            lg = memoryWallColor.g;
+            lb = memoryWallColor.b;
             col = TCODColor::white;
           }
         } else {
           // anti-aliased fov
-          static int dx[] = {-1, 0, 1, -1, 1, -1, 0, 1};
-          static int dy[] = {-1, -1, -1, 0, 0, 1, 1, 1};
-          int cnt = 0;
-          // count number of adjacent out of fov cells
-          for (int i = 0; i < 8; i++) {
-            int cx = dungeonx + dx[i];
-            int cy = dungeony + dy[i];
-            if (IN_RECTANGLE(cx, cy, dungeon->width * 2, dungeon->height * 2)) {
-              if (!dungeon->map2x->isInFov(cx, cy)) cnt++;
-            } else {
-              cnt++;
-            }
-          }
-          coef = 1.0f - cnt * 0.125f;
+          coef = (int)(dungeon->getFovCoef2x(dungeonx, dungeony) * 256);
         }
         if (lightIntensity > 30) {
-          dungeon->setMemory(dungeonx / 2, dungeony / 2);
+          memoryMarks[x / 2 + (y / 2) * (width / 2)] = 1;
         }
-        image.putPixel(x, y, col * lmcol * coef);
+        lightr[i] = lr;
+        lightg[i] = lg;
+        lightb[i] = lb;
+        groundr[i] = col.r;
+        groundg[i] = col.g;
+        groundb[i] = col.b;
+        coefs[i] = coef;
+      }
+      shadeRow(groundr.data(), lightr.data(), coefs.data(), outr.data(), count);
+      shadeRow(groundg.data(), lightg.data(), coefs.data(), outg.data(), count);
+      shadeRow(groundb.data(), lightb.data(), coefs.data(), outb.data(), count);
+      for (int i = 0; i < count; i++) {
+        image.putPixel(i + minx2x, y, TCODColor(outr[i], outg[i], outb[i]));
       }
     }
-  }
+  };
+  threadPool->parallelFor(miny2x / 2, maxy2x / 2 + 1, BAND_HEIGHT, shadeBand);
+  commitMemory(dungeon, minx2x, miny2x, maxx2x, maxy2x);
 }
 
 void LightMap::applyToImageOutdoor(TCODImage& image) {
+  PROFILE("applyToImageOutdoor");
   map::Dungeon* dungeon = gameEngine->dungeon;
   int maxx2x = width - 1;
   int maxy2x = height - 1;
-  for (int x = 0; x <= maxx2x; x++) {
-    for (int y = 0; y < maxy2x; y++) {
-      int dungeonx = x + gameEngine->xOffset * 2;
-      int dungeony = y + gameEngine->yOffset * 2;
-      if (!IN_RECTANGLE(dungeonx, dungeony, dungeon->width * 2, dungeon->height * 2)) {
-        image.putPixel(x, y, TCODColor::black);  // out of the map
-      } else {
-        // visible cell. shade it
-        HDRColor col = image.getPixel(x, y);
-        HDRColor lmcol = data2x[x + y * width];
-        lmcol = lmcol * col;
-        int lightIntensity = (int)(lmcol.r + lmcol.g + lmcol.b);
-        image.putPixel(x, y, lmcol);
-        if (lightIntensity > 30 && dungeon->map2x->isInFov(dungeonx, dungeony)) {
-          dungeon->setMemory(dungeonx / 2, dungeony / 2);
+  int offx2x = gameEngine->xOffset * 2;
+  int offy2x = gameEngine->yOffset * 2;
+  auto shadeBand = [&](int from, int to) {
+    std::vector<uint16_t> lightr(width), lightg(width), lightb(width);
+    std::vector<uint16_t> groundr(width), groundg(width), groundb(width);
+    std::vector<uint8_t> outr(width), outg(width), outb(width);
+    int bandMaxy = std::min(maxy2x + 1, to * 2);
+    for (int y = from * 2; y < bandMaxy; y++) {
+      for (int x = 0; x <= maxx2x; x++) {
+        TCODColor col = image.getPixel(x, y);
+        groundr[x] = col.r;
+        groundg[x] = col.g;
+        groundb[x] = col.b;
+      }
+      // shade the whole row
+      int off = y * width;
+      tonemapRow(&r[off], lightr.data(), maxx2x + 1);
+      tonemapRow(&g[off], lightg.data(), maxx2x + 1);
+      tonemapRow(&b[off], lightb.data(), maxx2x + 1);
+      shadeRowHdr(groundr.data(), lightr.data(), outr.data(), maxx2x + 1);
+      shadeRowHdr(groundg.data(), lightg.data(), outg.data(), maxx2x + 1);
+      shadeRowHdr(groundb.data(), lightb.data(), outb.data(), maxx2x + 1);
+      for (int x = 0; x <= maxx2x; x++) {
+        int dungeonx = x + offx2x;
+        int dungeony = y + offy2x;
+        if (!IN_RECTANGLE(dungeonx, dungeony, dungeon->width * 2, dungeon->height * 2)) {
+          image.putPixel(x, y, TCODColor::black);  // out of the map
+          continue;
+        }
+        // visible cell
+        image.putPixel(x, y, TCODColor(outr[x], outg[x], outb[x]));
+        int lightIntensity = (int)(outr[x]) + outg[x] + outb[x];
+        if (lightIntensity > 30 && dungeon->isInFov2x(dungeonx, dungeony)) {
+          memoryMarks[x / 2 + (y / 2) * (width / 2)] = 1;
         }
       }
     }
+  };
+  threadPool->parallelFor(0, maxy2x / 2 + 1, BAND_HEIGHT, shadeBand);
+  commitMemory(dungeon, 0, 0, maxx2x, maxy2x);
+}
+
+// setMemory also updates the neighbour cells. has to be done by a single thread
+void LightMap::commitMemory(map::Dungeon* dungeon, int minx2x, int miny2x, int maxx2x, int maxy2x) {
+  int offx = gameEngine->xOffset;
+  int offy = gameEngine->yOffset;
+  for (int y = miny2x / 2; y <= maxy2x / 2; y++) {
+    for (int x = minx2x / 2; x <= maxx2x / 2; x++) {
+      uint8_t& mark = memoryMarks[x + y * (width / 2)];
+      if (mark) {
+        dungeon->setMemory(x + offx, y + offy);
+        mark = 0;
+      }
+    }
   }
 }
 }  // namespace map
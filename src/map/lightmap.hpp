@@ -27,8 +27,11 @@
 #include <algorithm>
 #include <gsl/gsl>
 #include <libtcod.hpp>
+#include <vector>
 
 namespace map {
+class Dungeon;
+
 // color that can go beyond 0-255 range
 struct HDRColor {
   float r, g, b;
@@ -58,38 +61,69 @@ struct HDRColor {
 };
 HDRColor operator*(float value, const HDRColor& c);
 
+// light accumulation buffer at 2x console resolution.
+// one float plane per channel so that the row kernels can use SIMD
 class LightMap {
  public:
   LightMap(int width, int height);
   void clear(const TCODColor& col);
+  void clear(const TCODColor& col, int x, int y, int w, int h);  // only a rectangle, must be inside the map
+  void copy(const LightMap& src);  // src must have the same size
+  // pixel x,y takes the value of pixel x+dx,y+dy. the pixels coming from outside are not modified
+  void scroll(int dx, int dy);
   void applyToImage(
       TCODImage& img, int minx2x = 0, int miny2x = 0, int maxx2x = 0, int maxy2x = 0, bool playerFog = true);
   void applyToImageOutdoor(TCODImage& img);
-  inline TCODColor getColor2x(int x, int y) { return data2x[x + y * width]; }
-  inline TCODColor getColor(int x, int y) { return data[x + y * width / 2]; }
-  inline HDRColor& getHdrColor2x(int x, int y) { return data2x[x + y * width]; }
-  inline HDRColor& getHdrColor(int x, int y) { return data[x + y * width / 2]; }
-  inline void setColor2x(int x, int y, const TCODColor& col) {
-    data2x[x + y * width] = col;
-    if ((x & 1) == 0 && (y & 1) == 0) data[x / 2 + y * width / 4] = col;
+  inline TCODColor getColor2x(int x, int y) const { return getHdrColor2x(x, y); }
+  // the 1x map is not stored. it uses the top left subcell
+  inline TCODColor getColor(int x, int y) const { return getHdrColor2x(x * 2, y * 2); }
+  inline HDRColor getHdrColor2x(int x, int y) const {
+    int off = x + y * width;
+    return HDRColor(r[off], g[off], b[off]);
   }
+  inline HDRColor getHdrColor(int x, int y) const { return getHdrColor2x(x * 2, y * 2); }
   inline void setColor2x(int x, int y, const HDRColor& col) {
-    data2x[x + y * width] = col;
-    if ((x & 1) == 0 && (y & 1) == 0) data[x / 2 + y * width / 4] = col;
+    int off = x + y * width;
+    r[off] = col.r;
+    g[off] = col.g;
+    b[off] = col.b;
+  }
+  inline void addColor2x(int x, int y, const HDRColor& col) {
+    int off = x + y * width;
+    r[off] += col.r;
+    g[off] += col.g;
+    b[off] += col.b;
   }
+  // add count pixels of src starting at srcx,srcy, multiplied by mask (0 or 1), to this map at x,y
+  void addRow2x(int x, int y, const LightMap& src, int srcx, int srcy, int count, const float* mask);
 
-  float getFog(int x, int y);
-  float getPlayerFog(int x, int y);
+  float getFog(int x, int y);  // exact fog at a dungeon 2x position
+  float getPlayerFog(int x, int y);  // interpolated from the fog grid
   void update(float elapsed);
 
   int width, height;
   float fogRange;
 
  protected:
-  HDRColor* data2x = nullptr;
-  HDRColor* data = nullptr;
+  std::vector<float> r, g, b;
 
   float fogZ;
   TCODNoise* fogNoise = nullptr;
+
+  // fog noise sampled every FOG_STEP pixels over the lightmap area, for two z slices.
+  // only the new slice is computed when fogZ crosses a slice. everything is computed again when the view scrolls
+  std::vector<float> fogGrid[2];
+  int fogGridx = 0, fogGridy = 0;  // dungeon 2x position of the grid origin
+  int fogSlice = 0;  // z slice of fogGrid[0]
+  float fogSliceCoef = 0.0f;  // position of fogZ between the two slices
+  float getFogNoise(float fx, float fy, float fz);
+  void computeFogSlice(std::vector<float>& grid, int slice);
+  void updateFogGrid(int originx, int originy);
+  float getGridFog(int x, int y);
+
+  // cells to add to the player memory, one byte per console cell.
+  // the image is processed by bands of whole cell rows so that the threads never write the same byte
+  std::vector<uint8_t> memoryMarks;
+  void commitMemory(map::Dungeon* dungeon, int minx2x, int miny2x, int maxx2x, int maxy2x);
 };
 }  // namespace map
@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "map/pathfinder.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+
+namespace map {
+// same cost as the libtcod pathfinder diagonal steps
+static constexpr float DIAGONAL_COST = 1.41f;
+
+void ClusterGrid::init(int width, int height) {
+  this->width = width;
+  this->height = height;
+  clustersWidth = (width + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+  clustersHeight = (height + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+}
+
+void ClusterGrid::getClusterRect(int cluster, int* minx, int* miny, int* maxx, int* maxy) const {
+  *minx = (cluster % clustersWidth) * CLUSTER_SIZE;
+  *miny = (cluster / clustersWidth) * CLUSTER_SIZE;
+  *maxx = std::min(*minx + CLUSTER_SIZE, width) - 1;
+  *maxy = std::min(*miny + CLUSTER_SIZE, height) - 1;
+}
+
+ClusterGraph::ClusterGraph(int width, int height) {
+  grid.init(width, height);
+  int nbClusters = grid.clustersWidth * grid.clustersHeight;
+  clusters.resize(nbClusters);
+  dirty.assign(nbClusters, true);
+  for (int i = 0; i < nbClusters; i++) dirtyClusters.push_back(i);
+}
+
+void ClusterGraph::setDirty(int x, int y) {
+  // the entrances on the borders depend on the cells of both sides
+  for (int cy = std::max(y - 1, 0); cy <= std::min(y + 1, grid.height - 1); cy++) {
+    for (int cx = std::max(x - 1, 0); cx <= std::min(x + 1, grid.width - 1); cx++) {
+      int cluster = grid.getCluster(cx, cy);
+      if (!dirty[cluster]) {
+        dirty[cluster] = true;
+        dirtyClusters.push_back(cluster);
+      }
+    }
+  }
+}
+
+void ClusterGraph::update(const float* walkCosts) {
+  this->walkCosts = walkCosts;
+  for (int cluster : dirtyClusters) buildCluster(cluster);
+  dirtyClusters.clear();
+}
+
+void ClusterGraph::scanBorder(
+    int ax, int ay, int stepx, int stepy, int length, int crossx, int crossy, std::vector<std::pair<int, int>>& out)
+    const {
+  const int width = grid.width;
+  auto getPair = [&](int ka, int kb) {
+    return std::make_pair(
+        ax + ka * stepx + (ay + ka * stepy) * width, ax + kb * stepx + crossx + (ay + kb * stepy + crossy) * width);
+  };
+  auto isOpen = [&](int ka, int kb) {
+    return isWalkable(ax + ka * stepx, ay + ka * stepy) &&
+           isWalkable(ax + kb * stepx + crossx, ay + kb * stepy + crossy);
+  };
+  out.clear();
+  int runStart = -1;
+  for (int k = 0; k <= length; k++) {
+    bool open = k < length && isOpen(k, k);
+    if (open) {
+      if (runStart < 0) runStart = k;
+    } else if (runStart >= 0) {
+      int runLength = k - runStart;
+      if (runLength >= MIN_DOUBLE_ENTRANCE) {
+        out.push_back(getPair(runStart, runStart));
+        out.push_back(getPair(k - 1, k - 1));
+      } else {
+        out.push_back(getPair(runStart + runLength / 2, runStart + runLength / 2));
+      }
+      runStart = -1;
+    }
+    // the border can only be crossed diagonally here
+    if (!open && k + 1 < length && !isOpen(k + 1, k + 1)) {
+      if (isOpen(k, k + 1)) out.push_back(getPair(k, k + 1));
+      if (isOpen(k + 1, k)) out.push_back(getPair(k + 1, k));
+    }
+  }
+}
+
+void ClusterGraph::addLink(PathCluster& cluster, int node, int to) {
+  auto it = std::find(cluster.nodes.begin(), cluster.nodes.end(), node);
+  if (it == cluster.nodes.end()) {
+    cluster.nodes.push_back(node);
+    cluster.links.emplace_back();
+    it = cluster.nodes.end() - 1;
+  }
+  cluster.links[it - cluster.nodes.begin()].push_back(to);
+}
+
+void ClusterGraph::buildCluster(int index) {
+  const int width = grid.width;
+  const int height = grid.height;
+  auto cluster = std::make_shared<PathCluster>();
+  int minx, miny, maxx, maxy;
+  grid.getClusterRect(index, &minx, &miny, &maxx, &maxy);
+  std::vector<std::pair<int, int>> entrances;
+  // borders are always scanned from left to right and from top to bottom so that both sides find the same entrances
+  if (minx > 0) {
+    scanBorder(minx - 1, miny, 0, 1, maxy - miny + 1, 1, 0, entrances);
+    for (const auto& entrance : entrances) addLink(*cluster, entrance.second, entrance.first);
+  }
+  if (maxx < width - 1) {
+    scanBorder(maxx, miny, 0, 1, maxy - miny + 1, 1, 0, entrances);
+    for (const auto& entrance : entrances) addLink(*cluster, entrance.first, entrance.second);
+  }
+  if (miny > 0) {
+    scanBorder(minx, miny - 1, 1, 0, maxx - minx + 1, 0, 1, entrances);
+    for (const auto& entrance : entrances) addLink(*cluster, entrance.second, entrance.first);
+  }
+  if (maxy < height - 1) {
+    scanBorder(minx, maxy, 1, 0, maxx - minx + 1, 0, 1, entrances);
+    for (const auto& entrance : entrances) addLink(*cluster, entrance.first, entrance.second);
+  }
+  // corners, toward the diagonal neighbours
+  static constexpr int CORNERS = 4;
+  const int cornerx[CORNERS] = {minx, maxx, minx, maxx};
+  const int cornery[CORNERS] = {miny, miny, maxy, maxy};
+  for (int i = 0; i < CORNERS; i++) {
+    int tox = cornerx[i] + (i & 1 ? 1 : -1);
+    int toy = cornery[i] + (i & 2 ? 1 : -1);
+    if (tox < 0 || toy < 0 || tox >= width || toy >= height) continue;
+    if (isWalkable(cornerx[i], cornery[i]) && isWalkable(tox, toy)) {
+      addLink(*cluster, cornerx[i] + cornery[i] * width, tox + toy * width);
+    }
+  }
+  // walk costs between the entrances
+  int nbNodes = (int)cluster->nodes.size();
+  cluster->costs.assign(nbNodes * nbNodes, util::FlowField::UNREACHED);
+  for (int i = 0; i < nbNodes; i++) {
+    field.begin(minx, miny, maxx - minx + 1, maxy - miny + 1);
+    field.addSource(cluster->nodes[i] % width, cluster->nodes[i] / width);
+    field.compute(walkCosts + minx + miny * width, width);
+    for (int j = 0; j < nbNodes; j++) {
+      // the field gives the cost of walking from node j to node i
+      cluster->costs[j * nbNodes + i] = field.getDistance(cluster->nodes[j] % width, cluster->nodes[j] / width);
+    }
+  }
+  clusters[index] = cluster;
+  dirty[index] = false;
+}
+
+bool ClusterPathFinder::refine(
+    int ox, int oy, int dx, int dy, int minx, int miny, int maxx, int maxy, util::Path& path, const PathCost& cost) {
+  const int width = snapshot->grid.width;
+  int w = maxx - minx + 1;
+  int h = maxy - miny + 1;
+  // the policy grid is read in place unless the request adds its own costs
+  const float* costs = snapshot->costs[cost.policy]->data() + minx + miny * width;
+  int costsStride = width;
+  if (cost.hasOverlay()) {
+    windowCosts.resize(w * h);
+    for (int y = 0; y < h; y++) memcpy(&windowCosts[y * w], costs + y * width, w * sizeof(float));
+    for (int cell : cost.crowdedCells) {
+      int x = cell % width - minx;
+      int y = cell / width - miny;
+      if (x >= 0 && y >= 0 && x < w && y < h && windowCosts[x + y * w] > 0.0f) {
+        windowCosts[x + y * w] = PathCost::CROWD_COST;
+      }
+    }
+    if (cost.repulsorRange2 > 0.0f) {
+      for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+          float& c = windowCosts[x + y * w];
+          float rx = (float)(minx + x - cost.repulsorx), ry = (float)(miny + y - cost.repulsory);
+          float d2 = rx * rx + ry * ry;
+          if (c > 0.0f && d2 < cost.repulsorRange2) c += cost.repulsorCoef * (cost.repulsorRange2 - d2);
+        }
+      }
+    }
+    costs = windowCosts.data();
+    costsStride = w;
+  }
+  field.begin(minx, miny, w, h);
+  field.addSource(dx, dy);
+  field.compute(costs, costsStride);
+  if (!field.isReached(ox, oy)) return false;
+  int x = ox, y = oy;
+  while (x != dx || y != dy) {
+    if (!field.getNextStep(x, y, &x, &y, [](int, int) { return true; })) return false;
+    path.push(x, y);
+  }
+  return true;
+}
+
+bool ClusterPathFinder::searchAbstractPath(int ox, int oy, int dx, int dy, PathCostPolicy policy) {
+  const ClusterGrid& grid = snapshot->grid;
+  const int width = grid.width;
+  const float* walkCosts = snapshot->costs[policy]->data();
+  const std::vector<std::shared_ptr<const PathCluster>>& clusters = snapshot->clusters[policy];
+  const int origin = ox + oy * width;
+  const int goal = dx + dy * width;
+  const int originCluster = grid.getCluster(ox, oy);
+  const int goalCluster = grid.getCluster(dx, dy);
+  int minx, miny, maxx, maxy;
+  // costs between the origin and the entrances of its cluster
+  grid.getClusterRect(originCluster, &minx, &miny, &maxx, &maxy);
+  originField.begin(minx, miny, maxx - minx + 1, maxy - miny + 1);
+  originField.addSource(ox, oy);
+  originField.compute(walkCosts + minx + miny * width, width);
+  // costs between the entrances of the goal cluster and the goal
+  grid.getClusterRect(goalCluster, &minx, &miny, &maxx, &maxy);
+  goalField.begin(minx, miny, maxx - minx + 1, maxy - miny + 1);
+  goalField.addSource(dx, dy);
+  goalField.compute(walkCosts + minx + miny * width, width);
+
+  searchNodes.clear();
+  heap.clear();
+  auto heuristic = [&](int cell) {
+    // octile distance. the walk costs of all the policies are never below 1
+    int distx = abs(cell % width - dx);
+    int disty = abs(cell / width - dy);
+    return std::max(distx, disty) + (DIAGONAL_COST - 1.0f) * std::min(distx, disty);
+  };
+  auto relax = [&](int from, int to, float g) {
+    auto it = searchNodes.find(to);
+    if (it == searchNodes.end()) {
+      searchNodes[to] = SearchNode{g, from, false};
+    } else if (!it->second.closed && g < it->second.g) {
+      it->second.g = g;
+      it->second.parent = from;
+    } else {
+      return;
+    }
+    heap.push_back(std::make_pair(g + heuristic(to), to));
+    std::push_heap(heap.begin(), heap.end(), std::greater<>());
+  };
+  searchNodes[origin] = SearchNode{0.0f, -1, false};
+  heap.push_back(std::make_pair(heuristic(origin), origin));
+  bool found = false;
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+    int cell = heap.back().second;
+    heap.pop_back();
+    SearchNode& node = searchNodes[cell];
+    if (node.closed) continue;
+    node.closed = true;
+    float g = node.g;
+    if (cell == goal) {
+      found = true;
+      break;
+    }
+    int x = cell % width;
+    int y = cell / width;
+    int clusterIndex = grid.getCluster(x, y);
+    const PathCluster& cluster = *clusters[clusterIndex];
+    int nbNodes = (int)cluster.nodes.size();
+    if (cell == origin) {
+      for (int to : cluster.nodes) {
+        int tox = to % width, toy = to / width;
+        if (originField.isReached(tox, toy)) relax(cell, to, g + originField.getDistance(tox, toy));
+      }
+    }
+    if (clusterIndex == goalCluster && goalField.isReached(x, y)) relax(cell, goal, g + goalField.getDistance(x, y));
+    auto it = std::find(cluster.nodes.begin(), cluster.nodes.end(), cell);
+    if (it == cluster.nodes.end()) continue;
+    int i = (int)(it - cluster.nodes.begin());
+    for (int j = 0; j < nbNodes; j++) {
+      float cost = cluster.costs[i * nbNodes + j];
+      if (j != i && cost != util::FlowField::UNREACHED) relax(cell, cluster.nodes[j], g + cost);
+    }
+    for (int to : cluster.links[i]) {
+      bool diagonal = to % width != x && to / width != y;
+      relax(cell, to, g + walkCosts[cell] * (diagonal ? DIAGONAL_COST : 1.0f));
+    }
+  }
+  if (!found) return false;
+  waypoints.clear();
+  for (int cell = goal; cell != -1; cell = searchNodes[cell].parent) waypoints.push_back(cell);
+  std::reverse(waypoints.begin(), waypoints.end());
+  return true;
+}
+
+bool ClusterPathFinder::computePath(
+    const PathSnapshot& snapshot, int ox, int oy, int dx, int dy, util::Path& path, const PathCost& cost) {
+  static constexpr int CLUSTER_SIZE = ClusterGrid::CLUSTER_SIZE;
+  const ClusterGrid& grid = snapshot.grid;
+  this->snapshot = &snapshot;
+  path.clear();
+  if (ox < 0 || oy < 0 || ox >= grid.width || oy >= grid.height) return false;
+  if (dx < 0 || dy < 0 || dx >= grid.width || dy >= grid.height) return false;
+  if (!snapshot.isWalkable(dx, dy)) return false;
+  if (ox == dx && oy == dy) return true;
+  int ocx = ox / CLUSTER_SIZE, ocy = oy / CLUSTER_SIZE;
+  int dcx = dx / CLUSTER_SIZE, dcy = dy / CLUSTER_SIZE;
+  if (abs(ocx - dcx) <= 1 && abs(ocy - dcy) <= 1) {
+    // close enough for a direct search around both clusters
+    int minx = std::max(std::min(ocx, dcx) - 1, 0) * CLUSTER_SIZE;
+    int miny = std::max(std::min(ocy, dcy) - 1, 0) * CLUSTER_SIZE;
+    int maxx = std::min((std::max(ocx, dcx) + 2) * CLUSTER_SIZE, grid.width) - 1;
+    int maxy = std::min((std::max(ocy, dcy) + 2) * CLUSTER_SIZE, grid.height) - 1;
+    if (refine(ox, oy, dx, dy, minx, miny, maxx, maxy, path, cost)) return true;
+    // the path goes farther away
+    path.clear();
+  }
+  if (!searchAbstractPath(ox, oy, dx, dy, cost.policy)) return false;
+  for (int i = 1; i < (int)waypoints.size(); i++) {
+    int fromx = waypoints[i - 1] % grid.width, fromy = waypoints[i - 1] / grid.width;
+    int tox = waypoints[i] % grid.width, toy = waypoints[i] / grid.width;
+    if (abs(tox - fromx) <= 1 && abs(toy - fromy) <= 1) {
+      // crossing a border, or next to the origin or the goal
+      path.push(tox, toy);
+      continue;
+    }
+    // both waypoints are in the same cluster
+    int minx, miny, maxx, maxy;
+    grid.getClusterRect(grid.getCluster(tox, toy), &minx, &miny, &maxx, &maxy);
+    if (!refine(fromx, fromy, tox, toy, minx, miny, maxx, maxy, path, cost)) {
+      path.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+PathRequest::PathRequest(std::shared_ptr<const PathSnapshot> snapshot, int ox, int oy, int dx, int dy, PathCost cost)
+    : snapshot(std::move(snapshot)), ox(ox), oy(oy), dx(dx), dy(dy), cost(std::move(cost)) {
+  revision = this->snapshot->revision;
+}
+
+bool PathRequest::start() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (state != PENDING) return false;
+  state = RUNNING;
+  return true;
+}
+
+void PathRequest::compute() {
+  // one finder per thread
+  static thread_local ClusterPathFinder finder;
+  found = finder.computePath(*snapshot, ox, oy, dx, dy, path, cost);
+  std::lock_guard<std::mutex> lock(mutex);
+  state = DONE;
+  // under the lock. the request may be deleted as soon as it is unlocked
+  finished.notify_all();
+}
+
+void PathRequest::run() {
+  if (start()) compute();
+}
+
+bool PathRequest::isDone() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return state == DONE;
+}
+
+void PathRequest::wait() {
+  if (start()) {
+    compute();
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [this]() { return state == DONE; });
+}
+
+void PathRequest::cancel() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (state == PENDING) state = DONE;
+}
+}  // namespace map
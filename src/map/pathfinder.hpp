@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "util/flowfield.hpp"
+#include "util/path.hpp"
+
+namespace map {
+// the dungeon is split in CLUSTER_SIZE x CLUSTER_SIZE clusters for the hierarchical path searches
+struct ClusterGrid {
+  static constexpr int CLUSTER_SIZE = 16;
+  int width = 0, height = 0;  // in cells
+  int clustersWidth = 0, clustersHeight = 0;
+  void init(int width, int height);
+  inline int getCluster(int x, int y) const { return x / CLUSTER_SIZE + (y / CLUSTER_SIZE) * clustersWidth; }
+  // inclusive rectangle
+  void getClusterRect(int cluster, int* minx, int* miny, int* maxx, int* maxy) const;
+};
+
+// entrances of a cluster in the abstract graph
+struct PathCluster {
+  std::vector<int> nodes;  // entrance cells offsets
+  std::vector<float> costs;  // costs[i * nodes.size() + j] : walk cost from node i to node j across the cluster
+  std::vector<std::vector<int>> links;  // for each node, the entrance cells of the neighbour clusters it leads to
+};
+
+enum PathCostPolicy {
+  PATH_COST_TERRAIN,  // terrain walk costs
+  PATH_COST_UNIFORM,  // 1 for all walkable cells
+  PATH_COST_AVOID_WATER,  // terrain walk costs, 3 times higher on water
+  PATH_COST_WATER_ONLY,  // 1 for walkable water cells
+  NB_PATH_COST_POLICIES
+};
+
+// cost of walking out of each cell of the dungeon for a policy. 0 for blocked cells
+typedef std::vector<float> CostGrid;
+
+// walkability of a dungeon at a given revision.
+// never modified once built so that the background path searches can use it
+struct PathSnapshot {
+  uint32_t revision = 0;  // dungeon walkability revision
+  ClusterGrid grid;
+  // shared with the dungeon until it modifies them. NULL for the policies never used so far
+  std::shared_ptr<const CostGrid> costs[NB_PATH_COST_POLICIES];
+  // abstract graph of each policy. empty for the policies never used so far
+  std::vector<std::shared_ptr<const PathCluster>> clusters[NB_PATH_COST_POLICIES];
+  inline bool isWalkable(int x, int y) const { return (*costs[PATH_COST_TERRAIN])[x + y * grid.width] > 0.0f; }
+};
+
+// abstract graph of the hierarchical path searches for one cost policy. links the entrances between adjacent
+// clusters with their walk costs across each cluster. rebuilt one cluster at a time when the walk costs change
+class ClusterGraph {
+ public:
+  ClusterGraph(int width, int height);
+  // the walk cost of x,y changed. the clusters around it are rebuilt by the next update
+  void setDirty(int x, int y);
+  void update(const float* walkCosts);
+  // rebuilt clusters are new objects, so that the snapshots sharing the old ones are not affected
+  inline const std::vector<std::shared_ptr<const PathCluster>>& getClusters() const { return clusters; }
+
+ protected:
+  // runs of open border cells longer than this get an entrance at each end instead of one in the middle
+  static constexpr int MIN_DOUBLE_ENTRANCE = 6;
+  ClusterGrid grid;
+  std::vector<std::shared_ptr<const PathCluster>> clusters;
+  std::vector<bool> dirty;
+  std::vector<int> dirtyClusters;
+  const float* walkCosts = nullptr;
+  util::FlowField field;
+
+  inline bool isWalkable(int x, int y) const { return walkCosts[x + y * grid.width] > 0.0f; }
+  void buildCluster(int cluster);
+  // entrances across the border between the length cells starting at ax,ay along stepx,stepy
+  // and the cells next to them at crossx,crossy. pairs of cell offsets, the first one on the ax,ay side
+  void scanBorder(
+      int ax, int ay, int stepx, int stepy, int length, int crossx, int crossy, std::vector<std::pair<int, int>>& out)
+      const;
+  static void addLink(PathCluster& cluster, int node, int to);
+};
+
+// how a path search weights the cells. plain data so that the background searches can use it
+struct PathCost {
+  static constexpr float CROWD_COST = 50.0f;
+  PathCostPolicy policy = PATH_COST_TERRAIN;
+  std::vector<int> crowdedCells;  // offsets of the cells occupied by creatures. they cost CROWD_COST
+  // cells at a squared distance d2 < repulsorRange2 of the repulsor cost repulsorCoef * (repulsorRange2 - d2) more
+  int repulsorx = 0, repulsory = 0;
+  float repulsorRange2 = 0.0f;
+  float repulsorCoef = 0.0f;
+  inline bool hasOverlay() const { return !crowdedCells.empty() || repulsorRange2 > 0.0f; }
+};
+
+// hierarchical path search on a snapshot. long paths are searched on the abstract graph of the cost policy,
+// then refined one cluster at a time. keeps scratch buffers, so there is one finder per thread.
+// the crowded cells and the repulsor only apply to the refined steps : the abstract route ignores them, so a long
+// path can go through a crowd or near the repulsor when a detour in another cluster would cost less
+class ClusterPathFinder {
+ public:
+  // path from ox,oy to dx,dy
+  bool computePath(
+      const PathSnapshot& snapshot, int ox, int oy, int dx, int dy, util::Path& path, const PathCost& cost);
+
+ protected:
+  struct SearchNode {
+    float g;  // cost from the origin
+    int parent;  // cell offset, -1 for the origin
+    bool closed;
+  };
+  const PathSnapshot* snapshot = nullptr;
+  util::FlowField field, originField, goalField;
+  std::vector<float> windowCosts;
+  std::unordered_map<int, SearchNode> searchNodes;
+  std::vector<std::pair<float, int>> heap;
+  std::vector<int> waypoints;
+
+  // path inside the minx,miny,maxx,maxy rectangle (inclusive). the steps are appended to path
+  bool refine(
+      int ox, int oy, int dx, int dy, int minx, int miny, int maxx, int maxy, util::Path& path, const PathCost& cost);
+  bool searchAbstractPath(int ox, int oy, int dx, int dy, PathCostPolicy policy);
+};
+
+// a path search running in background
+class PathRequest {
+ public:
+  PathRequest(std::shared_ptr<const PathSnapshot> snapshot, int ox, int oy, int dx, int dy, PathCost cost);
+  // called by the thread pool. does nothing if the search was already taken by wait or cancel
+  void run();
+  bool isDone();
+  // block until the search is done. runs it on the calling thread if no worker started it yet
+  void wait();
+  // drop the search if no worker started it yet
+  void cancel();
+  // main thread only, once done. the snapshot holds the cost grids that the dungeon modifies in place
+  // when nothing else uses them. their use count must only change on the main thread
+  inline void releaseSnapshot() { snapshot = nullptr; }
+  // the walkability revision the path was computed for
+  inline uint32_t getRevision() const { return revision; }
+  // only valid once done
+  inline bool isFound() const { return found; }
+  inline util::Path& getPath() { return path; }
+
+ protected:
+  enum State { PENDING, RUNNING, DONE };
+  std::shared_ptr<const PathSnapshot> snapshot;
+  uint32_t revision;
+  int ox, oy, dx, dy;
+  PathCost cost;
+  util::Path path;
+  bool found = false;
+  State state = PENDING;
+  std::mutex mutex;
+  std::condition_variable finished;
+
+  // PENDING -> RUNNING. false if someone else took the search
+  bool start();
+  void compute();
+};
+}  // namespace map
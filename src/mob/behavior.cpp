@@ -37,36 +37,18 @@ TCODList<ScarePoint*> HerdBehavior::scare;
 
 #define FOLLOW_DIST 5
 
-float WaterOnlyWalkPattern::getWalkCost(int xFrom, int yFrom, int xTo, int yTo, void* userData) const {
-  map::Dungeon* dungeon = gameEngine->dungeon;
-  if (!dungeon->map->isWalkable(xTo, yTo)) return 0.0f;
-  if (!dungeon->hasRipples(xTo, yTo)) return 0.0f;
-  return 1.0f;
-}
-
-float AvoidWaterWalkPattern::getWalkCost(int xFrom, int yFrom, int xTo, int yTo, void* userData) const {
-  map::Dungeon* dungeon = gameEngine->dungeon;
-  if (!dungeon->map->isWalkable(xTo, yTo)) return 0.0f;
-  float cost = map::terrainTypes[dungeon->getTerrainType(xTo, yTo)].walkCost;
-  if (dungeon->hasRipples(xTo, yTo)) cost *= 3;  // try to avoid getting wet!
-  return cost;
-}
-
 bool FollowBehavior::update(Creature* crea, float elapsed) {
   int pdist = (int)crea->distance(*leader_);
   map::Dungeon* dungeon = gameEngine->dungeon;
   standDelay += elapsed;
-  if ((pdist > FOLLOW_DIST || standDelay > 10.0f) && (!crea->path_ || crea->path_->isEmpty())) {
+  if ((pdist > FOLLOW_DIST || standDelay > 10.0f) && crea->path_.isEmpty() && !crea->isWaitingForPath()) {
     // go near the leader
     int destx = (int)(leader_->x_ + TCODRandom::getInstance()->getInt(-FOLLOW_DIST, FOLLOW_DIST));
     int desty = (int)(leader_->y_ + TCODRandom::getInstance()->getInt(-FOLLOW_DIST, FOLLOW_DIST));
     destx = std::clamp(destx, 0, dungeon->width - 1);
     desty = std::clamp(desty, 0, dungeon->height - 1);
     dungeon->getClosestWalkable(&destx, &desty, true, true, false);
-    if (!crea->path_) {
-      crea->path_ = std::make_unique<TCODPath>(dungeon->width, dungeon->height, walkPattern, nullptr);
-    }
-    crea->path_->compute((int)crea->x_, (int)crea->y_, destx, desty);
+    crea->requestPath(destx, desty, walkPattern->getCostPolicy());
     crea->path_timer_ = 0.0f;
   } else {
     if (crea->walk(elapsed)) {
@@ -27,18 +27,24 @@
 #include <libtcod.hpp>
 
 #include "base/entity.hpp"
+#include "map/pathfinder.hpp"
 
 namespace mob {
-class WalkPattern : public ITCODPathCallback {
-  float getWalkCost(int, int, int, int, void*) const { return 1.0f; }
+class WalkPattern {
+ public:
+  virtual ~WalkPattern() = default;
+  // cost grid used by the path searches
+  virtual map::PathCostPolicy getCostPolicy() const { return map::PATH_COST_UNIFORM; }
 };
 
 class WaterOnlyWalkPattern : public WalkPattern {
-  float getWalkCost(int xFrom, int yFrom, int xTo, int yTo, void* userData) const;
+ public:
+  map::PathCostPolicy getCostPolicy() const override { return map::PATH_COST_WATER_ONLY; }
 };
 
 class AvoidWaterWalkPattern : public WalkPattern {
-  float getWalkCost(int xFrom, int yFrom, int xTo, int yTo, void* userData) const;
+ public:
+  map::PathCostPolicy getCostPolicy() const override { return map::PATH_COST_AVOID_WATER; }
 };
 
 class Creature;
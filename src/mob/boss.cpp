@@ -55,6 +55,7 @@ Boss::Boss() {
       strdup(config.getStringProperty("config.display.treasureIntensityPattern"));
 
   treasureLight = new map::ExtendedLight();
+  treasureLight->dynamic = true;
   treasureLight->color = treasureLightColor;
   treasureLight->range = treasureLightRange * 2;
   treasureLight->setup(treasureLightColor, treasureIntensityDelay, treasureIntensityPattern, NULL);
@@ -100,8 +101,10 @@ bool Boss::update(float elapsed) {
   static float summonTime = config.getFloatProperty("config.creatures.boss.summonTime");
   static int minionCount = config.getIntProperty("config.creatures.boss.minionCount");
   static float burnDamage = config.getFloatProperty("config.creatures.burnDamage");
+  static int secureDist = config.getIntProperty("config.creatures.boss.secureDist");
+  static float secureCoef = config.getFloatProperty("config.creatures.boss.secureCoef");
 
-  treasureLight->setPos(x_ * 2, y_ * 2);
+  gameEngine->dungeon->moveLight(treasureLight, x_ * 2, y_ * 2);
   if (life_ <= 0) {
     gameEngine->dungeon->removeLight(treasureLight);
     return false;
@@ -126,7 +129,7 @@ bool Boss::update(float elapsed) {
     }
   }
   if (pathTimer > pathDelay) {
-    if (!path_ || path_->isEmpty()) {
+    if (path_.isEmpty()) {
       // stay away from player
       // while staying in lair
       int destx, desty;
@@ -140,10 +143,16 @@ bool Boss::update(float elapsed) {
       destx = std::clamp(destx, 0, gameEngine->dungeon->width - 1);
       desty = std::clamp(desty, 0, gameEngine->dungeon->height - 1);
       gameEngine->dungeon->getClosestWalkable(&destx, &desty, true, true);
-      if (!path_) {
-        path_ = std::make_unique<TCODPath>(gameEngine->dungeon->width, gameEngine->dungeon->height, this, gameEngine);
+      // the boss don't like to be near player
+      map::PathCost cost;
+      cost.policy = map::PATH_COST_UNIFORM;
+      if (!ignore_creatures_) {
+        cost.repulsorx = (int)gameEngine->player.x_;
+        cost.repulsory = (int)gameEngine->player.y_;
+        cost.repulsorRange2 = (float)secureDist;
+        cost.repulsorCoef = secureCoef;
       }
-      path_->compute((int)x_, (int)y_, destx, desty);
+      gameEngine->dungeon->computePath((int)x_, (int)y_, destx, desty, path_, cost);
       pathTimer = 0.0f;
     } else
       walk(elapsed);
@@ -152,16 +161,4 @@ bool Boss::update(float elapsed) {
   }
   return life_ > 0;
 }
-
-float Boss::getWalkCost(int xFrom, int yFrom, int xTo, int yTo, void* userData) const {
-  static int secureDist = config.getIntProperty("config.creatures.boss.secureDist");
-  static float secureCoef = config.getFloatProperty("config.creatures.boss.secureCoef");
-
-  // the boss don't like to be near player
-  if (!gameEngine->dungeon->map->isWalkable(xTo, yTo)) return 0.0f;
-  if (ignore_creatures_) return 1.0f;
-  float pdist = SQRDIST(gameEngine->player.x_ - xTo, gameEngine->player.y_ - yTo);
-  if (pdist < secureDist) return 1.0f + secureCoef * (secureDist - pdist);
-  return 1.0f;
-}
 }  // namespace mob
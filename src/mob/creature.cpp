@@ -26,6 +26,7 @@
 #include "mob/creature.hpp"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "base/aidirector.hpp"
 #include "constants.hpp"
@@ -364,28 +365,59 @@ void Creature::render(map::LightMap& lightMap) {
 
 void Creature::stun(float delay) { walk_timer_ = std::min(-delay, walk_timer_); }
 
+void Creature::requestPath(int destx, int desty, map::PathCostPolicy policy) {
+  map::Dungeon* dungeon = gameEngine->dungeon;
+  map::PathCost cost;
+  cost.policy = policy;
+  if (!ignore_creatures_) dungeon->getCrowdedCells(&cost.crowdedCells);
+  pathRequest_ = dungeon->requestPath((int)x_, (int)y_, destx, desty, std::move(cost));
+  pathRequestDue_ = gameEngine->nbUpdates + PATH_REQUEST_DELAY;
+}
+
+bool Creature::pickUpPath() {
+  if (!pathRequest_ || gameEngine->nbUpdates < pathRequestDue_) return false;
+  std::shared_ptr<map::PathRequest> request = std::move(pathRequest_);
+  request->wait();
+  util::Path& path = request->getPath();
+  // discard the path if the walkability changed along it
+  if (!request->isFound() || !gameEngine->dungeon->isPathValid(request->getRevision(), path)) return false;
+  // the creature kept walking meanwhile. resume the path after its current position
+  for (int i = path.size() - 1; i >= 0; i--) {
+    int x, y;
+    path.get(i, &x, &y);
+    if (x == (int)x_ && y == (int)y_) {
+      path.skip(i + 1);
+      break;
+    }
+  }
+  if (!path.isEmpty()) {
+    int x, y;
+    path.get(0, &x, &y);
+    if (abs(x - (int)x_) > 1 || abs(y - (int)y_) > 1) return false;
+  }
+  path_ = std::move(path);
+  return true;
+}
+
 bool Creature::walk(float elapsed) {
+  pickUpPath();
   walk_timer_ += elapsed;
   map::TerrainId terrainId = gameEngine->dungeon->getTerrainType((int)x_, (int)y_);
   const float walkTime = map::terrainTypes[terrainId].walkCost / speed_;
   if (walk_timer_ >= 0) {
     walk_timer_ = -walkTime;
-    if (path_ && !path_->isEmpty()) {
+    if (!path_.isEmpty()) {
       int next_x{};
       int next_y{};
       base::GameEngine* game = gameEngine;
-      path_->get(0, &next_x, &next_y);
+      path_.get(0, &next_x, &next_y);
       if ((game->player.x_ != next_x || game->player.y_ != next_y) && !game->dungeon->hasCreature(next_x, next_y)) {
         const int old_x = (int)x_;
         const int old_y = (int)y_;
         int new_x = old_x;
         int new_y = old_y;
-        if (path_->walk(&new_x, &new_y, false)) {
-          setPos(new_x, new_y);
-          game->dungeon->moveCreature(this, old_x, old_y, new_x, new_y);
-          if (game->dungeon->hasRipples(new_x, new_y)) {
-            gameEngine->startRipple(new_x, new_y);
-          }
+        if (path_.walk(&new_x, &new_y)) {
+          stepTo(new_x, new_y);
           return true;
         }
       }
@@ -394,6 +426,39 @@ bool Creature::walk(float elapsed) {
   return false;
 }
 
+bool Creature::walkDownField(const util::FlowField& field, float elapsed) {
+  const int old_x = (int)x_;
+  const int old_y = (int)y_;
+  if (!field.isReached(old_x, old_y)) return false;
+  walk_timer_ += elapsed;
+  if (walk_timer_ >= 0) {
+    map::TerrainId terrainId = gameEngine->dungeon->getTerrainType(old_x, old_y);
+    walk_timer_ = -map::terrainTypes[terrainId].walkCost / speed_;
+    base::GameEngine* game = gameEngine;
+    int new_x{};
+    int new_y{};
+    // other creatures stand in the way. step around them or wait
+    if (field.getNextStep(old_x, old_y, &new_x, &new_y, [game](int x, int y) {
+          return (game->player.x_ != x || game->player.y_ != y) && game->dungeon->map->isWalkable(x, y) &&
+                 !game->dungeon->hasCreature(x, y);
+        })) {
+      stepTo(new_x, new_y);
+    }
+  }
+  return true;
+}
+
+void Creature::stepTo(int new_x, int new_y) {
+  base::GameEngine* game = gameEngine;
+  const int old_x = (int)x_;
+  const int old_y = (int)y_;
+  setPos(new_x, new_y);
+  game->dungeon->moveCreature(this, old_x, old_y, new_x, new_y);
+  if (game->dungeon->hasRipples(new_x, new_y)) {
+    gameEngine->startRipple(new_x, new_y);
+  }
+}
+
 void Creature::randomWalk(float elapsed) {
   walk_timer_ += elapsed;
   if (walk_timer_ >= 0) {
@@ -419,15 +484,6 @@ void Creature::randomWalk(float elapsed) {
   }
 }
 
-float Creature::getWalkCost(int, int, int xTo, int yTo, void*) const {
-  base::GameEngine* game = gameEngine;
-  if (!game->dungeon->map->isWalkable(xTo, yTo)) return 0.0f;
-  if (ignore_creatures_) return 1.0f;
-  if (game->dungeon->hasCreature(xTo, yTo)) return 50.0f;
-  if (game->player.x_ == xTo || game->player.y_ == yTo) return 50.0f;
-  return 1.0f;
-}
-
 void Creature::takeDamage(float amount) {
   current_damage_ += amount;
   int idmg = (int)current_damage_;
@@ -33,12 +33,18 @@
 #include "base/noisything.hpp"
 #include "base/savegame.hpp"
 #include "item.hpp"
+#include "map/pathfinder.hpp"
 #include "mob/behavior.hpp"
+#include "util/path.hpp"
 
 namespace screen {
 class Game;
 }
 
+namespace util {
+class FlowField;
+}
+
 namespace mob {
 class Creature;
 }
@@ -69,6 +75,8 @@ enum CreatureFlags {
 
 static constexpr auto VISIBLE_HEIGHT = 0.05f;
 static constexpr auto MIN_VISIBLE_HEIGHT = 0.02f;
+// game updates between a path request and the use of its result. the workers have that long to compute it
+static constexpr uint32_t PATH_REQUEST_DELAY = 2;
 
 enum ConditionTypeId {
   STUNNED,
@@ -114,7 +122,6 @@ class Condition {
 };
 
 class Creature : public base::DynamicEntity,
-                 public ITCODPathCallback,
                  public base::NoisyThing,
                  public base::SaveListener {
  public:
@@ -140,7 +147,6 @@ class Creature : public base::DynamicEntity,
   void renderTalk();
   virtual void takeDamage(float amount);
   virtual void stun(float delay);
-  virtual float getWalkCost(int xFrom, int yFrom, int xTo, int yTo, void* userData) const override;
   void talk(std::string_view text);
   bool isTalking() const noexcept { return talk_text_.delay > 0.0f; }
   bool isInRange(int x, int y);
@@ -176,7 +182,7 @@ class Creature : public base::DynamicEntity,
   float max_life_{};
   float speed_{};
   float height_{1.0f};  // in meters
-  std::unique_ptr<TCODPath> path_{};
+  util::Path path_{};
   bool ignore_creatures_{};  // walk mode
   bool burn_{};
   int flags_{};
@@ -199,9 +205,20 @@ class Creature : public base::DynamicEntity,
     float delay{};
   };
   bool walk(float elapsed);
+  // background path search toward destx,desty. the result replaces path_ PATH_REQUEST_DELAY updates later
+  void requestPath(int destx, int desty, map::PathCostPolicy policy);
+  inline bool isWaitingForPath() const { return pathRequest_ != nullptr; }
+  // replace path_ with the result of the path request once it is due, waiting for the search if needed.
+  // never earlier, so that the game doesn't depend on the threads timing. returns true if path_ changed
+  bool pickUpPath();
+  // walk down the field toward its sources. returns false if the creature is outside the field
+  bool walkDownField(const util::FlowField& field, float elapsed);
   void randomWalk(float elapsed);
+  void stepTo(int new_x, int new_y);
 
   std::vector<item::Item*> inventory_{};
+  std::shared_ptr<map::PathRequest> pathRequest_{};
+  uint32_t pathRequestDue_{};  // game update when the path request result is picked up
   float walk_timer_{};
   float path_timer_{};
   float current_damage_{};
@@ -69,6 +69,8 @@ void Fish::render(map::LightMap& lightMap) {
   TCODColor bgcol = gameEngine->ground.getPixel(conx2, cony2);
   rcol = TCODColor::lerp(bgcol, rcol, coef);
   gameEngine->ground.putPixel(conx2, cony2, rcol);
+  // drawn over the ground. restore it next frame
+  gameEngine->groundDirty.add(conx2, cony2, 1, 1);
 }
 
 void Fish::initItem() {
@@ -267,13 +267,6 @@ float Friend::getWalkCostHideAndSeek(int xFrom, int yFrom, int xTo, int yTo, voi
         return 1.0f;
 }
 */
-float Friend::getWalkCost(int xFrom, int yFrom, int xTo, int yTo, void* userData) const {
-  map::Dungeon* dungeon = gameEngine->dungeon;
-  if (!dungeon->map->isWalkable(xTo, yTo)) return 0.0f;
-  float cost = map::terrainTypes[dungeon->getTerrainType(xTo, yTo)].walkCost;
-  if (dungeon->hasWater(xTo * 2, yTo * 2)) cost *= 3;  // try to avoid getting wet!
-  return cost;
-}
 
 #define FRIE_CHUNK_VERSION 3
 void Friend::saveData(uint32_t chunkId, TCODZip* zip) {
@@ -39,7 +39,6 @@ class Friend : public Creature {
  public:
   Friend();
   bool update(float elapsed) override;
-  float getWalkCost(int xFrom, int yFrom, int xTo, int yTo, void* userData) const override;
 
   // SaveListener
   bool loadData(uint32_t chunkId, uint32_t chunkVersion, TCODZip* zip) override;
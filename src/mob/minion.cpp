@@ -127,20 +127,20 @@ bool Minion::update(float elapsed) {
   if (burn_ || !seen) {
     randomWalk(elapsed);
   } else {
-    // track player
-    if (!path_) {
-      path_ = std::make_unique<TCODPath>(game->dungeon->width, game->dungeon->height, this, game);
-    }
-    if (pathTimer > pathDelay) {
-      int dx, dy;
-      path_->getDestination(&dx, &dy);
-      if (dx != game->player.x_ || dy != game->player.y_) {
-        // path is no longer valid (the player moved)
-        path_->compute((int)x_, (int)y_, (int)game->player.x_, (int)game->player.y_);
-        pathTimer = 0.0f;
+    // track player. the player distance field is shared by all the minions.
+    // those too far to be in it compute their own path
+    if (!walkDownField(game->dungeon->getPlayerFlowField(), elapsed)) {
+      if (pathTimer > pathDelay && !isWaitingForPath()) {
+        int dx = -1, dy = -1;
+        path_.getDestination(&dx, &dy);
+        if (dx != game->player.x_ || dy != game->player.y_) {
+          // path is no longer valid (the player moved). keep walking the old one until the new one is ready
+          requestPath((int)game->player.x_, (int)game->player.y_, map::PATH_COST_UNIFORM);
+          pathTimer = 0.0f;
+        }
       }
+      walk(elapsed);
     }
-    walk(elapsed);
   }
   float dx = fabsf(game->player.x_ - x_);
   float dy = fabsf(game->player.y_ - y_);
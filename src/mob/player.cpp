@@ -52,6 +52,9 @@ Player::Player() {
   heal_light_.range = 7;
   heal_light_.randomRad = false;
   heal_light_.setup(healthColor, healthIntensityDelay, healthIntensityPattern, nullptr);
+  // both follow the player
+  light_.dynamic = true;
+  heal_light_.dynamic = true;
 
   max_life_ = 100.0f;
   sprint_delay_ = sprintLength;
@@ -72,7 +75,8 @@ float Player::getHealth() { return life_ / max_life_; }
 float Player::getHealing() { return std::min((life_ + heal_points_) / max_life_, 1.0f); }
 
 void Player::termLevel() {
-  path_ = nullptr;
+  path_.clear();
+  pathRequest_ = nullptr;
   walk_timer_ = 0.0f;
   init_dungeon_ = true;
 }
@@ -125,19 +129,13 @@ bool Player::setPath(int xDest, int yDest, bool limitPath) {
         return false;  // hit another wall. no path
     }
   }
-  if (!path_) path_ = std::make_unique<TCODPath>(dungeon->width, dungeon->height, this, nullptr);
+  // creatures make the path longer but never block it
   ignore_creatures_ = false;
-  bool ok = path_->compute((int)x_, (int)y_, xDest, yDest);
-  if (!ok) {
-    ignore_creatures_ = true;
-    ok = path_->compute((int)x_, (int)y_, xDest, yDest);
-  }
+  requestPath(xDest, yDest, map::PATH_COST_UNIFORM);
   ignore_creatures_ = true;
-  if (!ok) return false;
-  if (limitPath && !dungeon->getMemory(xDest, yDest) && path_->size() > maxPathFinding) {
-    path_ = nullptr;
-    return false;
-  }
+  // the length is checked when the path is ready
+  path_limit_ = limitPath && !dungeon->getMemory(xDest, yDest) ? maxPathFinding : 0;
+  path_failed_ = false;
   return true;
 }
 
@@ -316,15 +314,15 @@ bool Player::update(float elapsed, TCOD_key_t key, TCOD_mouse_t* mouse) {
   }
 
   if (life_ <= 0) return false;
-  light_.setPos(x_ * 2, y_ * 2);
+  dungeon->moveLight(&light_, x_ * 2, y_ * 2);
   updateConditions(elapsed);
 
   walk_timer_ += elapsed;
 
   // special key status
-  const bool ctrl = TCODConsole::isKeyPressed(TCODK_CONTROL);
+  const bool ctrl = base::current_held_keys.ctrl;
   // if ( key.vk == TCODK_SHIFT ) isSprinting=key.pressed;
-  is_sprinting_ = TCODConsole::isKeyPressed(TCODK_SHIFT);
+  is_sprinting_ = base::current_held_keys.shift;
 
   // user input
   if (gameEngine->isGamePaused()) {
@@ -348,11 +346,10 @@ bool Player::update(float elapsed, TCOD_key_t key, TCOD_mouse_t* mouse) {
 
   {
     // Hack to fix movement.
-    const auto [new_dx, new_dy] = base::get_current_movement_dir();
-    left_ = new_dx < 0;
-    right_ = new_dx > 0;
-    up_ = new_dy < 0;
-    down_ = new_dy > 0;
+    left_ = base::current_held_keys.dx < 0;
+    right_ = base::current_held_keys.dx > 0;
+    up_ = base::current_held_keys.dy < 0;
+    down_ = base::current_held_keys.dy > 0;
   }
 
   // mouse coordinates
@@ -466,6 +463,14 @@ bool Player::update(float elapsed, TCOD_key_t key, TCOD_mouse_t* mouse) {
   map::TerrainId terrainId = dungeon->getTerrainType((int)x_, (int)y_);
   const float walkTime = map::terrainTypes[terrainId].walkCost * maxInvSpeed;
   if (walk_timer_ >= 0) {
+    bool waitingForPath = isWaitingForPath();
+    bool found = pickUpPath();
+    if (waitingForPath && !isWaitingForPath()) {
+      // the search is over. don't keep walking the previous path if it failed
+      if (found && path_limit_ > 0 && path_.size() > path_limit_) found = false;
+      if (!found) path_.clear();
+      path_failed_ = !found;
+    }
     bool hasWalked = false;
     const int old_x = (int)x_;
     const int old_y = (int)y_;
@@ -481,9 +486,8 @@ bool Player::update(float elapsed, TCOD_key_t key, TCOD_mouse_t* mouse) {
     if (dx != 0 || dy != 0) {
       int old_new_x = new_x;
       int old_new_y = new_y;
-      if (path_) {
-        path_ = nullptr;
-      }
+      path_.clear();
+      pathRequest_ = nullptr;
       if (IN_RECTANGLE(new_x, new_y, dungeon->width, dungeon->height) && !dungeon->hasCreature(new_x, new_y) &&
           dungeon->map->isWalkable(new_x, new_y)) {
         x_ = gsl::narrow_cast<float>(new_x);
@@ -600,15 +604,15 @@ bool Player::update(float elapsed, TCOD_key_t key, TCOD_mouse_t* mouse) {
           }
         }
       }
-    } else if (path_ && !path_->isEmpty()) {
-      path_->get(0, &new_x, &new_y);
+    } else if (!path_.isEmpty()) {
+      path_.get(0, &new_x, &new_y);
       if (!dungeon->hasCreature(new_x, new_y)) {
-        path_->walk(&new_x, &new_y, false);
+        path_.walk(&new_x, &new_y);
         setPos(new_x, new_y);
         gameEngine->stats.nbSteps++;
         hasWalked = true;
       } else {
-        path_ = nullptr;  // the path is obstructed. cancel it
+        path_.clear();  // the path is obstructed. cancel it
       }
     }
     // auto pickup items
@@ -631,7 +635,7 @@ bool Player::update(float elapsed, TCOD_key_t key, TCOD_mouse_t* mouse) {
   }
   // healing effect
   updateHealing(elapsed);
-  heal_light_.setPos(x_ * 2, y_ * 2);
+  dungeon->moveLight(&heal_light_, x_ * 2, y_ * 2);
   return true;
 }
 
@@ -39,7 +39,10 @@ class Player : public Creature {
  public:
   Player();
   void init();
+  // false if the destination is rejected right away. the search runs in background :
+  // hasPathFailed tells if it found no path, or one longer than the limit, once the result is picked up
   bool setPath(int xDest, int yDest, bool limitPath = true);
+  inline bool hasPathFailed() const { return path_failed_; }
   bool update(float elapsed, TCOD_key_t key, TCOD_mouse_t* mouse);
   void takeDamage(float amount) override;
   void termLevel();
@@ -82,6 +85,8 @@ class Player : public Creature {
   map::ExtendedLight heal_light_{};
   bool init_dungeon_{true};
   bool is_sprinting_{};
+  int path_limit_{};  // maximum length of the requested path. 0 = no limit
+  bool path_failed_{};  // the last path search found no usable path
 
   void computeFovRange(float elapsed);
   void computeAverageSpeed(float elapsed);
@@ -167,7 +167,10 @@ static LayeredTerrain forestTypes[NB_FORESTS] = {
 enum { DBG_HEIGHTMAP, DBG_SHADOWHEIGHT, DBG_FOV, DBG_NORMALMAP, DBG_CLOUDS, DBG_WATERCOEF, NB_DEBUGMAPS };
 static const char* debugMapNames[] = {"heightmap", "shadowheight", "fov", "normalmap", "clouds", "waterCoef"};
 
+ForestScreen* ForestScreen::instance = NULL;
+
 ForestScreen::ForestScreen() {
+  instance = this;
   forestRng = NULL;
   debugMap = 0;
   fade_in_length_ms_ = fade_out_length_ms_ = (int)(config.getFloatProperty("config.display.fadeTime") * 1000);
@@ -175,90 +178,110 @@ ForestScreen::ForestScreen() {
 
 void ForestScreen::render() {
   static bool debug = config.getBoolProperty("config.debug");
+  PROFILE("render");
   // draw subcell ground
   int squaredFov = (int)(player.fov_range_ * player.fov_range_ * 4);
-  int minx, maxx, miny, maxy;
-  bool showDebugMap = false;
-  ground.clear(TCODColor::black);
-  base::Rect r1(xOffset * 2, yOffset * 2, CON_W * 2, CON_H * 2);
-  base::Rect r2(0, 0, dungeon->width * 2, dungeon->height * 2);
-  r1.intersect(r2);
-  minx = (int)(r1.x_ - xOffset * 2);
-  maxx = (int)(r1.x_ + r1.w_ - xOffset * 2);
-  miny = (int)(r1.y_ - yOffset * 2);
-  maxy = (int)(r1.y_ + r1.h_ - yOffset * 2);
+  bool showDebugMap = debug && TCODConsole::isKeyPressed(TCODK_TAB) && TCODConsole::isKeyPressed(TCODK_SHIFT);
   float fovRatio = 1.0f / (aspectRatio * aspectRatio);
-  for (int x = minx; x < maxx; x++) {
-    for (int y = miny; y < maxy; y++) {
-      int dungeon2x = x + xOffset * 2;
-      int dungeon2y = y + yOffset * 2;
-      TCODColor col;
-      int dx = (int)(dungeon2x - player.x_ * 2);
-      int dy = (int)(dungeon2y - player.y_ * 2);
-      /*
-                              // in fov range, you see under the tree tops
-                              // out of range, you see the tree tops
-                              if ( dx*dx+dy*dy <= squaredFov ) {
-                                      col=dungeon->getShadedGroundColor(dungeon2x,dungeon2y);
-                                      if ( ! dungeon->map2x->isInFov(dungeon2x,dungeon2y) ) col = col * 0.8;
-      */
-      if (dx * dx + dy * dy * fovRatio <= squaredFov && dungeon->map2x->isInFov(dungeon2x, dungeon2y)) {
-        col = dungeon->getShadedGroundColor(dungeon2x, dungeon2y);
-      } else {
-        col = dungeon->canopy->getPixel(dungeon2x, dungeon2y);
-        if (col.r == 0) {
+  checkGroundChanges();
+  if (showDebugMap || groundDebugMap || player.fov_range_ != groundFovRange) groundDirty.addAll();
+  if (player.x_ != groundPlayerx || player.y_ != groundPlayery ||
+      dungeon->getTransparencyRevision() != groundTransparencyRevision) {
+    // the player fov only changes the ground in fov range
+    int rx = (int)(player.fov_range_ * 2) + 2;
+    int ry = (int)(player.fov_range_ * 2 * aspectRatio) + 2;
+    addDirtyGroundRect((int)(groundPlayerx * 2) - rx, (int)(groundPlayery * 2) - ry, 2 * rx + 1, 2 * ry + 1);
+    addDirtyGroundRect((int)(player.x_ * 2) - rx, (int)(player.y_ * 2) - ry, 2 * rx + 1, 2 * ry + 1);
+  }
+  groundDebugMap = showDebugMap;
+  groundFovRange = player.fov_range_;
+  groundPlayerx = player.x_;
+  groundPlayery = player.y_;
+  groundTransparencyRevision = dungeon->getTransparencyRevision();
+  for (const base::Rect& r : groundDirty.getRects()) {
+    int minx = (int)r.x_;
+    int miny = (int)r.y_;
+    int maxx = minx + r.w_;
+    int maxy = miny + r.h_;
+    for (int x = minx; x < maxx; x++) {
+      for (int y = miny; y < maxy; y++) {
+        int dungeon2x = x + xOffset * 2;
+        int dungeon2y = y + yOffset * 2;
+        if (!IN_RECTANGLE(dungeon2x, dungeon2y, dungeon->width * 2, dungeon->height * 2)) {
+          ground.putPixel(x, y, TCODColor::black);
+          continue;
+        }
+        TCODColor col;
+        int dx = (int)(dungeon2x - player.x_ * 2);
+        int dy = (int)(dungeon2y - player.y_ * 2);
+        /*
+                                // in fov range, you see under the tree tops
+                                // out of range, you see the tree tops
+                                if ( dx*dx+dy*dy <= squaredFov ) {
+                                        col=dungeon->getShadedGroundColor(dungeon2x,dungeon2y);
+                                        if ( ! dungeon->isInFov2x(dungeon2x,dungeon2y) ) col = col * 0.8;
+        */
+        if (dx * dx + dy * dy * fovRatio <= squaredFov && dungeon->isInFov2x(dungeon2x, dungeon2y)) {
           col = dungeon->getShadedGroundColor(dungeon2x, dungeon2y);
         } else {
-          col = col * dungeon->getInterpolatedCloudCoef(dungeon2x, dungeon2y);
+          col = dungeon->canopy->getPixel(dungeon2x, dungeon2y);
+          if (col.r == 0) {
+            col = dungeon->getShadedGroundColor(dungeon2x, dungeon2y);
+          } else {
+            col = col * dungeon->getInterpolatedCloudCoef(dungeon2x, dungeon2y);
+          }
         }
-      }
 
-      // debug maps
-      if (debug && TCODConsole::isKeyPressed(TCODK_TAB) && TCODConsole::isKeyPressed(TCODK_SHIFT)) {
-        switch (debugMap) {
-          case DBG_HEIGHTMAP: {
-            float h = dungeon->hmap->getValue(dungeon2x, dungeon2y);
-            col = h * TCODColor::white;
-          } break;
-          case DBG_SHADOWHEIGHT: {
-            float h = dungeon->getShadowHeight(dungeon2x, dungeon2y);
-            col = h * TCODColor::white;
-          } break;
-          case DBG_FOV: {
-            col = dungeon->map2x->isInFov(dungeon2x, dungeon2y) ? TCODColor::lightGrey : TCODColor::darkGrey;
-          } break;
-          case DBG_NORMALMAP: {
-            float n[3];
-            dungeon->hmap->getNormal(dungeon2x, dungeon2y, n);
-            col = TCODColor((int)(128 + n[0] * 128), (int)(128 + n[1] * 128), (int)(128 + n[2] * 128));
-          } break;
-          case DBG_CLOUDS: {
-            float h = dungeon->getInterpolatedCloudCoef(dungeon2x, dungeon2y);
-            h = (h - 0.5f) / 1.2f;
-            col = h * TCODColor::white;
-          } break;
-          case DBG_WATERCOEF: {
-            float h = dungeon->getWaterCoef(dungeon2x, dungeon2y);
-            col = h * TCODColor::white;
-          } break;
+        // debug maps
+        if (showDebugMap) {
+          switch (debugMap) {
+            case DBG_HEIGHTMAP: {
+              float h = dungeon->hmap->getValue(dungeon2x, dungeon2y);
+              col = h * TCODColor::white;
+            } break;
+            case DBG_SHADOWHEIGHT: {
+              float h = dungeon->getShadowHeight(dungeon2x, dungeon2y);
+              col = h * TCODColor::white;
+            } break;
+            case DBG_FOV: {
+              col = dungeon->isInFov2x(dungeon2x, dungeon2y) ? TCODColor::lightGrey : TCODColor::darkGrey;
+            } break;
+            case DBG_NORMALMAP: {
+              float n[3];
+              dungeon->hmap->getNormal(dungeon2x, dungeon2y, n);
+              col = TCODColor((int)(128 + n[0] * 128), (int)(128 + n[1] * 128), (int)(128 + n[2] * 128));
+            } break;
+            case DBG_CLOUDS: {
+              float h = dungeon->getInterpolatedCloudCoef(dungeon2x, dungeon2y);
+              h = (h - 0.5f) / 1.2f;
+              col = h * TCODColor::white;
+            } break;
+            case DBG_WATERCOEF: {
+              float h = dungeon->getWaterCoef(dungeon2x, dungeon2y);
+              col = h * TCODColor::white;
+            } break;
+          }
         }
-        showDebugMap = true;
-      }
 
-      ground.putPixel(x, y, col);
+        ground.putPixel(x, y, col);
+      }
     }
   }
+  groundDirty.clear();
   // render the subcell creatures
   dungeon->renderSubcellCreatures(lightMap);
-  // draw ripples
-  if (!showDebugMap) rippleManager->renderRipples(ground);
+  // draw ripples. ripples and fireballs are drawn over the ground. their area is composited again next frame
+  if (!showDebugMap) rippleManager->renderRipples(ground, &groundDirty);
   // render the fireballs
   for (spell::FireBall** it = fireballs.begin(); it != fireballs.end(); it++) {
-    (*it)->render(ground);
+    (*it)->render(ground, &groundDirty);
   }
 
   // blit it on console
-  ground.blit2x(TCODConsole::root, 0, 0);
+  {
+    PROFILE("blit2x");
+    ground.blit2x(TCODConsole::root, 0, 0);
+  }
   // render the items
   dungeon->renderItems(lightMap);
   // render the creatures
@@ -274,6 +297,7 @@ void ForestScreen::render() {
   }
   // apply sepia post-processing
   if (pauseCoef != 0.0f) {
+    PROFILE("sepia");
     for (int x = 0; x < CON_W; x++) {
       for (int y = 0; y < CON_H; y++) {
         TCODColor bk = TCODConsole::root->getCharBackground(x, y);
@@ -294,11 +318,13 @@ void ForestScreen::render() {
   }
 
   // TCODConsole::root->print(0,2,"player pos %d %d\nfriend pos %d %d\n",player.x,player.y,fr->x,fr->y);
+  renderProfiler();
   if (player.name_.empty()) textInput.render(CON_W / 2, 2);
 }
 
 bool ForestScreen::update(float elapsed, TCOD_key_t k, TCOD_mouse_t mouse) {
   static bool debug = config.getBoolProperty("config.debug");
+  PROFILE("update");
 
   mousex = mouse.cx;
   mousey = mouse.cy;
@@ -603,6 +629,8 @@ else if ( swimmable2 ) waterCoef2=layer2Height;
   float t1 = TCODSystem::getElapsedSeconds();
   DBG(("Forest generation end. %g sec\n", t1 - t0));
 #endif
+  displayProgress(1.0f);
+  mapReady = true;
 }
 
 // SaveListener
@@ -655,12 +683,15 @@ void ForestScreen::onActivate() {
   TCODConsole::setFade(255, TCODColor::black);
   TCODConsole::setColorControl(TCOD_COLCTRL_1, TCODColor(255, 255, 240), TCODColor::black);
   TCODConsole::setColorControl(TCOD_COLCTRL_2, ui::guiHighlightedText, TCODColor::black);
+  // the background generation must be over before the random generators are reset.
+  // no main menu when running headless
+  if (MainMenu::instance) MainMenu::instance->waitForForestGen();
   GameEngine::onActivate();
   init();
-  MainMenu::instance->waitForForestGen();
 
   if (newGame) {
-    generateMap(saveGame.seed);
+    if (!mapReady) generateMap(saveGame.seed);
+    mapReady = false;
     dungeon->setPlayerStartingPosition();
     int fx, fy;
     fr = new mob::Friend();
@@ -37,6 +37,7 @@ class ForestScreen : public base::GameEngine, public base::SaveListener {
   mob::Friend* fr;
 
   ForestScreen();
+  static ForestScreen* instance;
 
   void render() override;
   bool update(float elapsed, TCOD_key_t k, TCOD_mouse_t mouse) override;
@@ -45,6 +46,7 @@ class ForestScreen : public base::GameEngine, public base::SaveListener {
   void loadMap(uint32_t seed);  // load map from savegame
 
   void onFontChange();
+  const char* getReplayName() const override { return "forest"; }
 
   // SaveListener
   bool loadData(uint32_t chunkId, uint32_t chunkVersion, TCODZip* zip) override;
@@ -52,6 +54,7 @@ class ForestScreen : public base::GameEngine, public base::SaveListener {
 
  protected:
   TCODRandom* forestRng;
+  bool mapReady{};  // generateMap already done (in background by the main menu)
 
   void onActivate() override;
   void onDeactivate() override;
@@ -59,5 +62,9 @@ class ForestScreen : public base::GameEngine, public base::SaveListener {
   void placeHouse(map::Dungeon* dungeon, int doorx, int doory, base::Entity::Direction dir);
   int debugMap;
   ui::TextInput textInput;
+  // player state of the last composited ground
+  float groundPlayerx{}, groundPlayery{}, groundFovRange{};
+  uint32_t groundTransparencyRevision{};
+  bool groundDebugMap{};
 };
 }  // namespace screen
@@ -138,7 +138,7 @@ void Game::render() {
     for (int x = minx; x <= maxx; x++) {
       int dx2 = (conExploX - x) * (conExploX - x);
       for (int y = miny; y <= maxy; y++) {
-        if (dungeon->map2x->isInFov(x + xOffset2, y + yOffset2) &&
+        if (dungeon->isInFov2x(x + xOffset2, y + yOffset2) &&
             dungeon->map->isWalkable(x / 2 + xOffset, y / 2 + yOffset)) {
           int dy = conExploY - y;
           float r = dx2 + dy * dy;
@@ -181,7 +181,10 @@ void Game::render() {
   }
 
   // blit it on console
-  ground.blit2x(TCODConsole::root, 0, 0);
+  {
+    PROFILE("blit2x");
+    ground.blit2x(TCODConsole::root, 0, 0);
+  }
 
   // render the corpses
   dungeon->renderCorpses(lightMap);
@@ -252,6 +255,7 @@ void Game::render() {
           util::blitTransparent(pauseScreen,0,0,CON_W-20,CON_H-20,TCODConsole::root,10,5);
   }
   */
+  renderProfiler();
 }
 
 bool Game::update(float elapsed, TCOD_key_t k, TCOD_mouse_t mouse) {
@@ -30,6 +30,8 @@
 
 #include "constants.hpp"
 #include "main.hpp"
+#include "screen/forest.hpp"
+#include "screen/school.hpp"
 #include "util/subcell.hpp"
 
 namespace screen {
@@ -50,23 +52,17 @@ static const char* menuNames[MENU_NB_ITEMS] = {"New game", "Continue", "Exit"};
 MainMenu::MainMenu() : Screen(0), selectedItem(0), elapsed(0.0f), noiseZ(0.0f) {
   instance = this;
   worldGenJobId = -1;
+  forestGenJobId = -1;
   fade_in_length_ms_ = (int)(config.getFloatProperty("config.display.fadeTime") * 1000);
   fade_out_length_ms_ = fade_in_length_ms_ / 2;
 }
 
-struct WorldGenThreadData {
-  TCOD_semaphore_t worldDone;
-  uint32_t seed;
-};
-
 int generateWorld(void* dat) {
   uint32_t seed = (uint32_t)(uintptr_t)dat;
   if (config.getBoolProperty("config.debug")) {
     printf("World seed : %d\n", seed);
   }
-  // DISABLED
-  //	SchoolScreen::instance->generateWorld(seed);
-  //	TCODSystem::unlockSemaphore(data->worldDone);
+  SchoolScreen::instance->generateWorld(seed);
   return 0;
 }
 
@@ -75,19 +71,21 @@ int generateForest(void* dat) {
   if (config.getBoolProperty("config.debug")) {
     printf("Forest seed : %d\n", seed);
   }
-  //	ForestScreen::instance->generateMap(seed);
-  //	TCODSystem::unlockSemaphore(data->worldDone);
+  ForestScreen::instance->generateMap(seed);
   return 0;
 }
 
-int loadForest(void* dat) {
-  uint32_t seed = (uint32_t)(uintptr_t)dat;
-  if (config.getBoolProperty("config.debug")) {
-    printf("Forest seed : %d\n", seed);
+// start generating the maps as soon as the seed is known.
+// saved games are still loaded when the forest screen is activated
+void MainMenu::startBackgroundGen() {
+  if (newGame && forestGenJobId == -1 && ForestScreen::instance) {
+    // the dungeon reports its progress through gameEngine
+    gameEngine = ForestScreen::instance;
+    forestGenJobId = threadPool->addJob(generateForest, (void*)(uintptr_t)saveGame.seed);
+  }
+  if (worldGenJobId == -1 && SchoolScreen::instance) {
+    worldGenJobId = threadPool->addJob(generateWorld, (void*)(uintptr_t)saveGame.seed);
   }
-  //	ForestScreen::instance->loadMap(seed);
-  //	TCODSystem::unlockSemaphore(data->worldDone);
-  return 0;
 }
 
 void MainMenu::onInitialise() {
@@ -98,7 +96,6 @@ void MainMenu::onInitialise() {
   titlex = CON_W - titlew / 2;
   titley = CON_H / 3 + 28;
   fire = new util::Fire(titlew, titleh + 10);
-  worldDone = TCODSystem::newSemaphore(0);
   rock = new TCODImage("data/img/rock.png");
   rockNormal = new TCODImage("data/img/rock_n.png");
 }
@@ -113,11 +110,7 @@ void MainMenu::onActivate() {
   elapsed = 0.0f;
   smokeElapsed = 0.0f;
   noiseZ += 0.1f;
-  static WorldGenThreadData data;
-  data.worldDone = worldDone;
-  data.seed = saveGame.seed;
-  forestGenJobId = threadPool->addJob(newGame ? generateForest : loadForest, (void*)data.seed);
-  worldGenJobId = threadPool->addJob(generateWorld, &data);
+  startBackgroundGen();
   menu.push(MENU_NEW_GAME);
   if (!newGame) {
     menu.push(MENU_CONTINUE);
@@ -304,6 +297,19 @@ void MainMenu::render() {
 
   TCODConsole::root->setDefaultForeground(TEXT_COLOR);
   TCODConsole::root->printEx(CON_W - 2, CON_H - 2, TCOD_BKGND_NONE, TCOD_RIGHT, "v" VERSION);
+  if (forestGenJobId != -1 && threadPool->isMultiThreadEnabled()) {
+    if (threadPool->isFinished(forestGenJobId)) {
+      forestGenJobId = -1;
+    } else {
+      TCODConsole::root->printEx(
+          CON_W - 2,
+          CON_H - 3,
+          TCOD_BKGND_NONE,
+          TCOD_RIGHT,
+          "Generating the forest %d%%",
+          (int)(ForestScreen::instance->getProgress() * 100));
+    }
+  }
 
   if (userPref.nbLaunches == 1) {
     TCODConsole::root->printEx(
@@ -326,12 +332,10 @@ bool MainMenu::update(float el, TCOD_key_t k, TCOD_mouse_t mouse) {
           engine.deactivateAll();
           // new game
           if (!newGame) {
-            // cancel the background generation for the saved game
-            if (threadPool->isMultiThreadEnabled()) {
-              // TODO : being able to cancel the jobs
-              waitForForestGen();
-              waitForWorldGen();
-            }
+            // the jobs use the seed of the saved game
+            // TODO : being able to cancel the jobs
+            waitForForestGen();
+            waitForWorldGen();
             saveGame.init();
             newGame = true;
             delete rng;
@@ -339,11 +343,7 @@ bool MainMenu::update(float el, TCOD_key_t k, TCOD_mouse_t mouse) {
               printf("New random seed : %d\n", saveGame.seed);
             }
             rng = new TCODRandom(saveGame.seed, TCOD_RNG_CMWC);
-            static WorldGenThreadData data;
-            data.worldDone = worldDone;
-            data.seed = saveGame.seed;
-            forestGenJobId = threadPool->addJob(generateForest, (void*)data.seed);
-            worldGenJobId = threadPool->addJob(generateWorld, &data);
+            startBackgroundGen();
           }
           engine.activateModule("chapter1Story");
           return false;
@@ -390,11 +390,22 @@ bool MainMenu::update(float el, TCOD_key_t k, TCOD_mouse_t mouse) {
 }
 
 void MainMenu::waitForWorldGen() {
-  // TCODSystem::lockSemaphore(worldDone);
-  // threadPool->waitUntilFinished(worldGenJobId);
+  if (worldGenJobId == -1) return;
+  threadPool->waitUntilFinished(worldGenJobId);
+  worldGenJobId = -1;
 }
+
 void MainMenu::waitForForestGen() {
-  // TCODSystem::lockSemaphore(worldDone);
-  // threadPool->waitUntilFinished(forestGenJobId);
+  if (forestGenJobId == -1) return;
+  if (threadPool->isMultiThreadEnabled()) {
+    // keep the progress bar moving
+    while (!threadPool->isFinished(forestGenJobId)) {
+      ForestScreen::instance->displayProgress(ForestScreen::instance->getProgress());
+      TCODSystem::sleepMilli(20);
+    }
+  } else {
+    threadPool->waitUntilFinished(forestGenJobId);
+  }
+  forestGenJobId = -1;
 }
 }  // namespace screen
@@ -46,17 +46,16 @@ class MainMenu : public Screen {
   void onInitialise() override;
   void onActivate() override;
   void computeSmoke(float z, TCODImage* img, int miny, int maxy);
+  void startBackgroundGen();
   TCODList<MenuItemId> menu;
   int selectedItem;
   float elapsed;
   float smokeElapsed;
   float noiseZ;
   TCODImage* img;
+  // background map generation jobs. -1 when not running
   int worldGenJobId;
   int forestGenJobId;
-  // for background world generation
-  TCOD_thread_t backgroundThread;
-  TCOD_semaphore_t worldDone;
   // title position & size
   int titlex, titley, titlew, titleh;
   util::Fire* fire;
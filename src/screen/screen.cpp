@@ -25,6 +25,7 @@
  */
 #include "screen.hpp"
 
+#include "base/movement.hpp"
 #include "constants.hpp"
 #include "main.hpp"
 
@@ -130,6 +131,7 @@ bool Screen::update() {
     }
     if (fadeEnded) fade_level_ = 0.0f;
   }
+  base::current_held_keys = base::poll_held_keys();
   return update(elapsed, key_, ms_);
 }
 
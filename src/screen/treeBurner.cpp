@@ -123,6 +123,7 @@ TreeBurner::TreeBurner() {
 
 void TreeBurner::render() {
   static bool debug = config.getBoolProperty("config.debug");
+  PROFILE("render");
   // draw subcell ground
   int squaredFov = (int)(player.fov_range_ * player.fov_range_ * 4);
   int minx, maxx, miny, maxy;
@@ -136,21 +137,38 @@ void TreeBurner::render() {
   miny = (int)(r1.y_ - yOffset * 2);
   maxy = (int)(r1.y_ + r1.h_ - yOffset * 2);
   float fovRatio = 1.0f / (aspectRatio * aspectRatio);
+  // ambient light with the trees and clouds shadows. only the dirty parts are computed again
+  checkGroundChanges();
+  if (dungeon->getAmbient() != groundAmbient) {
+    groundAmbient = dungeon->getAmbient();
+    groundDirty.addAll();
+  }
+  for (const base::Rect& r : groundDirty.getRects()) {
+    for (int x = (int)r.x_; x < (int)r.x_ + r.w_; x++) {
+      for (int y = (int)r.y_; y < (int)r.y_ + r.h_; y++) {
+        int dungeon2x = x + xOffset * 2;
+        int dungeon2y = y + yOffset * 2;
+        if (!IN_RECTANGLE(dungeon2x, dungeon2y, dungeon->width * 2, dungeon->height * 2)) {
+          ambientLightMap.setColor2x(x, y, TCODColor::black);
+          continue;
+        }
+        float intensity = dungeon->getShadow(dungeon2x, dungeon2y);
+        float cloudIntensity = dungeon->getInterpolatedCloudCoef(dungeon2x, dungeon2y);
+        intensity = std::min(intensity, cloudIntensity);
+        TCODColor lightCol = groundAmbient;
+        if (intensity < 1.0f) {
+          lightCol = lightCol * intensity;
+        }
+        ambientLightMap.setColor2x(x, y, lightCol);
+      }
+    }
+  }
+  groundDirty.clear();
+  lightMap.copy(ambientLightMap);
+  // the ground colors change when burnt. always read them
   for (int x = minx; x < maxx; x++) {
     for (int y = miny; y < maxy; y++) {
-      int dungeon2x = x + xOffset * 2;
-      int dungeon2y = y + yOffset * 2;
-      TCODColor col = dungeon->getGroundColor(dungeon2x, dungeon2y);
-
-      ground.putPixel(x, y, col);
-      float intensity = dungeon->getShadow(dungeon2x, dungeon2y);
-      float cloudIntensity = dungeon->getInterpolatedCloudCoef(dungeon2x, dungeon2y);
-      intensity = std::min(intensity, cloudIntensity);
-      TCODColor lightCol = dungeon->getAmbient();
-      if (intensity < 1.0f) {
-        lightCol = lightCol * intensity;
-      }
-      lightMap.setColor2x(x, y, lightCol);
+      ground.putPixel(x, y, dungeon->getGroundColor(x + xOffset * 2, y + yOffset * 2));
     }
   }
   // render the subcell creatures
@@ -194,7 +212,7 @@ void TreeBurner::render() {
             col = h * TCODColor::white;
           } break;
           case DBG_FOV: {
-            col = dungeon->map2x->isInFov(dungeon2x, dungeon2y) ? TCODColor::lightGrey : TCODColor::darkGrey;
+            col = dungeon->isInFov2x(dungeon2x, dungeon2y) ? TCODColor::lightGrey : TCODColor::darkGrey;
           } break;
           case DBG_NORMALMAP: {
             float n[3];
@@ -220,7 +238,7 @@ void TreeBurner::render() {
       if (!showDebugMap &&
           (((!playerBuilding || dungeon->getCell(dungeon2x / 2, dungeon2y / 2)->building != playerBuilding) &&
             dx * dx + dy * dy * fovRatio > squaredFov) ||
-           !dungeon->map2x->isInFov(dungeon2x, dungeon2y))) {
+           !dungeon->isInFov2x(dungeon2x, dungeon2y))) {
         col = dungeon->canopy->getPixel(dungeon2x, dungeon2y);
         if (col.r != 0) {
           col = col * dungeon->getInterpolatedCloudCoef(dungeon2x, dungeon2y);
@@ -246,7 +264,10 @@ void TreeBurner::render() {
   }
 
   // blit it on console
-  ground.blit2x(TCODConsole::root, 0, 0);
+  {
+    PROFILE("blit2x");
+    ground.blit2x(TCODConsole::root, 0, 0);
+  }
   // render the corpses
   dungeon->renderCorpses(lightMap);
   // render the items
@@ -267,6 +288,7 @@ void TreeBurner::render() {
   }
   // apply sepia post-processing
   if (pauseCoef != 0.0f) {
+    PROFILE("sepia");
     for (int x = 0; x < CON_W; x++) {
       for (int y = 0; y < CON_H; y++) {
         TCODColor bk = TCODConsole::root->getCharBackground(x, y);
@@ -290,10 +312,12 @@ void TreeBurner::render() {
     TCODConsole::root->setDefaultForeground(TCODColor::lightRed);
     TCODConsole::root->printEx(40, 2, TCOD_BKGND_NONE, TCOD_CENTER, "VICTORY");
   }
+  renderProfiler();
 }
 
 bool TreeBurner::update(float elapsed, TCOD_key_t k, TCOD_mouse_t mouse) {
   static bool debug = config.getBoolProperty("config.debug");
+  PROFILE("update");
   static TCODColor sunColor = config.getColorProperty("config.display.sunColor");
   static TCODColor dawnColor = config.getColorProperty("config.display.dawnColor");
 
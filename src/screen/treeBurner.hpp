@@ -40,12 +40,14 @@ class TreeBurner : public base::GameEngine {
   void loadMap(uint32_t seed);  // load map from savegame
 
   void onFontChange();
+  const char* getReplayName() const override { return "treeburner"; }
 
  protected:
   TCODRandom* forestRng;
 
   void onActivate() override;
   void onDeactivate() override;
+  void scrollGround(int dx2, int dy2) override { ambientLightMap.scroll(dx2, dy2); }
   void placeTree(map::Dungeon* dungeon, int x, int y, const item::ItemType* treeType);
   void placeHouse(map::Dungeon* dungeon, int doorx, int doory, base::Entity::Direction dir);
   int debugMap;
@@ -53,5 +55,7 @@ class TreeBurner : public base::GameEngine {
   mob::Creature* boss;
   int cityWallX;
   float endTimer;
+  map::LightMap ambientLightMap{CON_W * 2, CON_H * 2};  // lightMap before the lights are added
+  TCODColor groundAmbient;  // ambient light of ambientLightMap
 };
 }  // namespace screen
@@ -56,6 +56,7 @@ FireBall::FireBall(float xFrom, float yFrom, int xTo, int yTo, FireBallType type
 
   light.x_ = x_ * 2;
   light.y_ = y_ * 2;
+  light.dynamic = true;
 
   dx_ = xTo - xFrom;
   dy_ = yTo - yFrom;
@@ -138,7 +139,7 @@ void FireBall::render(map::LightMap& lightMap) {
       int lmx = (int)((*it)->x) - gameEngine->xOffset * 2;
       int lmy = (int)((*it)->y) - gameEngine->yOffset * 2;
       if (IN_RECTANGLE(lmx, lmy, lightMap.width, lightMap.height)) {
-        if (gameEngine->dungeon->map2x->isInFov((int)((*it)->x), (int)((*it)->y))) {
+        if (gameEngine->dungeon->isInFov2x((int)((*it)->x), (int)((*it)->y))) {
           map::HDRColor lcol = lightMap.getColor2x(lmx, lmy);
           lcol = lcol + light.color;
           lightMap.setColor2x(lmx, lmy, lcol);
@@ -148,7 +149,18 @@ void FireBall::render(map::LightMap& lightMap) {
   }
 }
 
-void FireBall::render(TCODImage& ground) {
+void FireBall::render(TCODImage& ground, util::DirtyRects* dirty) {
+  // bounding box of the modified pixels
+  int minx = CON_W * 2, miny = CON_H * 2, maxx = -1, maxy = -1;
+  auto addPixel = [&](int x, int y, const TCODColor& col) {
+    TCODColor lcol = ground.getPixel(x, y);
+    lcol = lcol + col;
+    ground.putPixel(x, y, lcol);
+    minx = std::min(minx, x);
+    miny = std::min(miny, y);
+    maxx = std::max(maxx, x);
+    maxy = std::max(maxy, y);
+  };
   if (effect == FIREBALL_MOVE) {
     float curx = fx_ * 2 - gameEngine->xOffset * 2;
     float cury = fy_ * 2 - gameEngine->yOffset * 2;
@@ -156,11 +168,7 @@ void FireBall::render(TCODImage& ground) {
     for (int i = 0; i < type_data_->trailLength; i++) {
       int icurx = (int)curx;
       int icury = (int)cury;
-      if (IN_RECTANGLE(icurx, icury, CON_W * 2, CON_H * 2)) {
-        TCODColor lcol = ground.getPixel(icurx, icury);
-        lcol = lcol + col;
-        ground.putPixel(icurx, icury, lcol);
-      }
+      if (IN_RECTANGLE(icurx, icury, CON_W * 2, CON_H * 2)) addPixel(icurx, icury, col);
       curx -= dx_;
       cury -= dy_;
       col = col * 0.8f;
@@ -170,14 +178,11 @@ void FireBall::render(TCODImage& ground) {
       int lmx = (int)((*it)->x) - gameEngine->xOffset * 2;
       int lmy = (int)((*it)->y) - gameEngine->yOffset * 2;
       if (IN_RECTANGLE(lmx, lmy, CON_W * 2, CON_H * 2)) {
-        if (gameEngine->dungeon->map2x->isInFov((int)((*it)->x), (int)((*it)->y))) {
-          TCODColor lcol = ground.getPixel(lmx, lmy);
-          lcol = lcol + light.color;
-          ground.putPixel(lmx, lmy, lcol);
-        }
+        if (gameEngine->dungeon->isInFov2x((int)((*it)->x), (int)((*it)->y))) addPixel(lmx, lmy, light.color);
       }
     }
   }
+  if (dirty && maxx >= minx) dirty->add(minx, miny, maxx - minx + 1, maxy - miny + 1);
 }
 
 bool FireBall::updateMove(float elapsed) {
@@ -189,8 +194,7 @@ bool FireBall::updateMove(float elapsed) {
   fy_ += dy_ * type_data_->speed;
   x_ = (int)fx_;
   y_ = (int)fy_;
-  light.x_ = x_ * 2;
-  light.y_ = y_ * 2;
+  dungeon->moveLight(&light, x_ * 2, y_ * 2);
   if (type == FB_SPARK) {
     fx_life_ -= elapsed / type_data_->sparkLife;
     if (fx_life_ < 0.0f) return false;
@@ -285,8 +289,7 @@ bool FireBall::updateMove(float elapsed) {
       }
     }
     if (end) {
-      light.x_ = x_ * 2;
-      light.y_ = y_ * 2;
+      dungeon->moveLight(&light, x_ * 2, y_ * 2);
       // start effect
       fx_life_ = 1.0f;
       switch (type) {
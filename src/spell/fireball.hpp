@@ -30,6 +30,7 @@
 #include "base/noisything.hpp"
 #include "map/light.hpp"
 #include "map/lightmap.hpp"
+#include "util/dirtyrects.hpp"
 
 namespace spell {
 typedef enum { FB_SPARK, FB_STANDARD, FB_BURST, FB_INCANDESCENCE } FireBallType;
@@ -53,7 +54,7 @@ class FireBall : public base::Entity, public base::NoisyThing {
   ~FireBall();
 
   void render(map::LightMap& lightMap);
-  void render(TCODImage& ground);
+  void render(TCODImage& ground, util::DirtyRects* dirty = NULL);  // the modified pixels are added to dirty
   bool update(float elapsed);
 
  protected:
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/bitgrid.hpp"
+
+#include <algorithm>
+
+namespace util {
+void BitGrid::resize(int width, int height) {
+  this->width = width;
+  this->height = height;
+  stride = (width + 63) >> 6;
+  words.assign(stride * height, 0);
+}
+
+void BitGrid::clear() { std::fill(words.begin(), words.end(), 0); }
+
+int BitGrid::countRowTriplet(int x, int y) const {
+  // number of bits in a 3 bits value
+  static const int BITS3[8] = {0, 1, 1, 2, 1, 2, 2, 3};
+  const uint64_t* row = &words[y * stride];
+  uint64_t bits;
+  if (x == 0) {
+    // x-1 is outside the grid
+    bits = (row[0] << 1) & 7;
+  } else {
+    int start = x - 1;
+    int word = start >> 6;
+    int bit = start & 63;
+    bits = row[word] >> bit;
+    // the triplet overlaps the next word
+    if (bit > 61 && word + 1 < stride) bits |= row[word + 1] << (64 - bit);
+    bits &= 7;
+  }
+  return BITS3[bits];
+}
+
+int BitGrid::countNeighbours(int x, int y) const {
+  // padding bits after the row end are never set
+  int count = countRowTriplet(x, y) - (get(x, y) ? 1 : 0);
+  if (y > 0) count += countRowTriplet(x, y - 1);
+  if (y < height - 1) count += countRowTriplet(x, y + 1);
+  return count;
+}
+
+// keep one bit out of two (the even ones) and pack them in the lower 32 bits
+static inline uint64_t packEvenBits(uint64_t v) {
+  v &= 0x5555555555555555ULL;
+  v = (v | (v >> 1)) & 0x3333333333333333ULL;
+  v = (v | (v >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+  v = (v | (v >> 4)) & 0x00FF00FF00FF00FFULL;
+  v = (v | (v >> 8)) & 0x0000FFFF0000FFFFULL;
+  v = (v | (v >> 16)) & 0x00000000FFFFFFFFULL;
+  return v;
+}
+
+void BitGrid::downsample(const BitGrid& src) {
+  for (int y = 0; y < height; y++) {
+    uint64_t* row = &words[y * stride];
+    const uint64_t* src0 = &src.words[y * 2 * src.stride];
+    const uint64_t* src1 = src0 + src.stride;
+    std::fill(row, row + stride, 0);
+    for (int w = 0; w < src.stride; w++) {
+      // vertical or, then horizontal or of each bits pair
+      uint64_t v = src0[w] | src1[w];
+      v = packEvenBits(v | (v >> 1));
+      row[w >> 1] |= v << ((w & 1) * 32);
+    }
+  }
+}
+
+// octant transformations
+static const int OCTANT_MULT[4][8] = {
+    {1, 0, 0, -1, -1, 0, 0, 1},
+    {0, 1, -1, 0, 0, -1, 1, 0},
+    {0, 1, 1, 0, 0, -1, -1, 0},
+    {1, 0, 0, 1, -1, 0, 0, -1}};
+
+struct ShadowCaster {
+  const BitGrid& transparent;
+  BitGrid& fov;
+  int fovx, fovy;
+  int ox, oy;
+  int radius;
+  bool lightWalls;
+
+  inline void mark(int x, int y) {
+    x -= fovx;
+    y -= fovy;
+    if (x >= 0 && y >= 0 && x < fov.getWidth() && y < fov.getHeight()) fov.set(x, y, true);
+  }
+
+  void castLight(int row, float start, float end, int xx, int xy, int yx, int yy) {
+    if (start < end) return;
+    int squaredRadius = radius * radius;
+    float newStart = 0.0f;
+    for (int j = row; j <= radius; j++) {
+      int dy = -j;
+      bool blocked = false;
+      for (int dx = -j; dx <= 0; dx++) {
+        float leftSlope = (dx - 0.5f) / (dy + 0.5f);
+        float rightSlope = (dx + 0.5f) / (dy - 0.5f);
+        if (start < rightSlope) continue;
+        if (end > leftSlope) break;
+        int cx = ox + dx * xx + dy * xy;
+        int cy = oy + dx * yx + dy * yy;
+        bool inMap = cx >= 0 && cy >= 0 && cx < transparent.getWidth() && cy < transparent.getHeight();
+        // the map is convex, a ray leaving it never comes back. outside cells can be transparent
+        bool opaque = inMap && !transparent.get(cx, cy);
+        if (inMap && dx * dx + dy * dy <= squaredRadius && (lightWalls || !opaque)) mark(cx, cy);
+        if (blocked) {
+          if (opaque) {
+            newStart = rightSlope;
+          } else {
+            blocked = false;
+            start = newStart;
+          }
+        } else if (opaque && j < radius) {
+          // start of a wall. scan the next row up to this wall
+          blocked = true;
+          castLight(j + 1, start, leftSlope, xx, xy, yx, yy);
+          newStart = rightSlope;
+        }
+      }
+      if (blocked) break;
+    }
+  }
+};
+
+void computeShadowcastingFov(
+    const BitGrid& transparent, int x, int y, int radius, bool lightWalls, BitGrid& fov, int fovx, int fovy) {
+  // the viewer can be out of the map
+  ShadowCaster caster{transparent, fov, fovx, fovy, x, y, radius, lightWalls};
+  if (x >= 0 && y >= 0 && x < transparent.getWidth() && y < transparent.getHeight()) caster.mark(x, y);
+  for (int octant = 0; octant < 8; octant++) {
+    caster.castLight(
+        1,
+        1.0f,
+        0.0f,
+        OCTANT_MULT[0][octant],
+        OCTANT_MULT[1][octant],
+        OCTANT_MULT[2][octant],
+        OCTANT_MULT[3][octant]);
+  }
+}
+}  // namespace util
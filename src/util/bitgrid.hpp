@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace util {
+// one bit per cell. each row is padded to a whole number of 64 bits words
+class BitGrid {
+ public:
+  BitGrid() = default;
+  BitGrid(int width, int height) { resize(width, height); }
+  void resize(int width, int height);
+  inline int getWidth() const { return width; }
+  inline int getHeight() const { return height; }
+  inline bool isEmpty() const { return words.empty(); }
+  inline bool get(int x, int y) const { return (words[y * stride + (x >> 6)] >> (x & 63)) & 1; }
+  inline void set(int x, int y, bool value) {
+    uint64_t& word = words[y * stride + (x >> 6)];
+    uint64_t mask = (uint64_t)1 << (x & 63);
+    if (value) {
+      word |= mask;
+    } else {
+      word &= ~mask;
+    }
+  }
+  void clear();
+  // count set cells among the 8 neighbours of x,y. cells outside the grid are not set
+  int countNeighbours(int x, int y) const;
+  // this cell is set if any of the 2x2 src cells is set. src must be twice as large as this grid
+  void downsample(const BitGrid& src);
+
+ protected:
+  int width = 0, height = 0;
+  int stride = 0;  // words per row
+  std::vector<uint64_t> words;
+
+  // count bits at x-1,x,x+1 of row y
+  int countRowTriplet(int x, int y) const;
+};
+
+// recursive shadowcasting fov from x,y on a transparency grid.
+// set the visible cells in fov, which covers the area starting at fovx,fovy of the transparency grid
+void computeShadowcastingFov(
+    const BitGrid& transparent, int x, int y, int radius, bool lightWalls, BitGrid& fov, int fovx = 0, int fovy = 0);
+}  // namespace util
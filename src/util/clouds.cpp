@@ -30,6 +30,9 @@
 #include "main.hpp"
 
 namespace util {
+// number of interpolation steps between two cloud columns
+static const int CLOUD_STEPS = 8;
+
 // returns a value between 0.5 and 1.2
 // 50% chances between 0.5 and 1.0 (clouds), 50% chances between 1.0 and 1.2 (clear sky)
 static inline float noiseFunc(float* f) {
@@ -91,7 +94,7 @@ float CloudBox::getData(float* pdata, int x, int y) {
 float CloudBox::getInterpolatedData(float* pdata, int x, int y) {
   int realX = (x + x0) % width;
   int maxX = (x0 - 1 + width) % width;
-  float fx = realX + xOffset;
+  float fx = realX + stepOffset;
   int ix = realX;
   int iy = y;
   int ix1 = ix == maxX ? maxX : (ix + 1) % width;
@@ -142,6 +145,12 @@ void CloudBox::update(float elapsed) {
       noiseX += 1.0f;
       colsToTranslate--;
     }
+    revision++;
+  }
+  float newStepOffset = floorf(xOffset * CLOUD_STEPS) / CLOUD_STEPS;
+  if (newStepOffset != stepOffset) {
+    stepOffset = newStepOffset;
+    revision++;
   }
 }
 }  // namespace util
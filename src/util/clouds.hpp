@@ -35,11 +35,16 @@ class CloudBox {
   float getThickness(int x, int y);
   TCODColor getColor(float thickness, int x, int y);
   void update(float elapsed);
+  // changes each time the clouds visibly move
+  inline int getRevision() const { return revision; }
 
  protected:
   int width, height, x0;
   float *data, xOffset, xTotalOffset;
   float* highOctaveNoise = nullptr;
+  // the interpolation between two columns is done by steps so that the screen can be reused between two steps
+  float stepOffset = 0.0f;
+  int revision = 0;
   TCODColor cloudColorMap[256];
   float getNoisierThickness(int x, int y);
   float getData(float* data, int x, int y);
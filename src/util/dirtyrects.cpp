@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/dirtyrects.hpp"
+
+#include <algorithm>
+
+namespace util {
+void DirtyRects::add(int x, int y, int w, int h) {
+  if (full) return;
+  int minx = std::max(0, x);
+  int miny = std::max(0, y);
+  int maxx = std::min(width, x + w);
+  int maxy = std::min(height, y + h);
+  if (minx >= maxx || miny >= maxy) return;
+  base::Rect r(minx, miny, maxx - minx, maxy - miny);
+  for (base::Rect& dirty : rects) {
+    if (dirty.isIntersecting(r)) {
+      dirty.merge(r);
+      return;
+    }
+  }
+  rects.push_back(r);
+  if ((int)rects.size() > MAX_RECTS) {
+    // too many small rectangles. use the bounding box
+    for (size_t i = 1; i < rects.size(); i++) rects[0].merge(rects[i]);
+    rects.resize(1);
+  }
+}
+
+void DirtyRects::translate(int dx, int dy) {
+  if (full) return;
+  std::vector<base::Rect> old;
+  old.swap(rects);
+  for (const base::Rect& r : old) add((int)r.x_ + dx, (int)r.y_ + dy, r.w_, r.h_);
+}
+}  // namespace util
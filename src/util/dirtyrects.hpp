@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <vector>
+
+#include "base/entity.hpp"
+
+namespace util {
+// parts of a screen buffer that must be drawn again.
+// touching rectangles are merged, and everything is merged in one rectangle when there are too many of them
+class DirtyRects {
+ public:
+  DirtyRects(int width, int height) : width(width), height(height) {}
+  void add(int x, int y, int w, int h);  // clipped to the buffer
+  inline void add(const base::Rect& r) { add((int)r.x_, (int)r.y_, r.w_, r.h_); }
+  inline void addAll() {
+    rects.clear();
+    rects.emplace_back(0, 0, width, height);
+    full = true;
+  }
+  inline void clear() {
+    rects.clear();
+    full = false;
+  }
+  // move the rectangles with the buffer content. the parts going out of the buffer are dropped
+  void translate(int dx, int dy);
+  inline bool isEmpty() const { return rects.empty(); }
+  inline bool isFull() const { return full; }
+  inline const std::vector<base::Rect>& getRects() const { return rects; }
+
+ protected:
+  static constexpr int MAX_RECTS = 16;
+  int width, height;
+  bool full = false;
+  std::vector<base::Rect> rects;
+};
+}  // namespace util
@@ -183,6 +183,7 @@ void FireManager::removeZone(int x, int y, int w, int h) {
 }
 
 void FireManager::update(float elapsed) {
+  PROFILE("FireManager::update");
   static float zoneDecay = config.getFloatProperty("config.fireManager.zoneDecay");
   el += elapsed;
   if (el < UPDATE_DELAY) return;
@@ -268,6 +269,7 @@ void FireManager::update(float elapsed) {
 }
 
 void FireManager::renderFire(TCODImage& ground) {
+  PROFILE("FireManager::renderFire");
   int dx = gameEngine->xOffset * 2;
   int dy = gameEngine->yOffset * 2;
   screenFireZone.x_ = std::max(gsl::narrow_cast<float>(dx), screenFireZone.x_);
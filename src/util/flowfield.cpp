@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/flowfield.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace util {
+// same cost as the libtcod pathfinder diagonal steps
+static constexpr float DIAGONAL_COST = 1.41f;
+
+void FlowField::begin(int minx, int miny, int width, int height) {
+  this->minx = minx;
+  this->miny = miny;
+  this->width = width;
+  this->height = height;
+  dist.assign(width * height, UNREACHED);
+  heap.clear();
+}
+
+void FlowField::addSource(int x, int y, float d) {
+  if (!isInside(x, y)) return;
+  int offset = (x - minx) + (y - miny) * width;
+  if (d >= dist[offset]) return;
+  dist[offset] = d;
+  heap.push_back(std::make_pair(d, offset));
+  std::push_heap(heap.begin(), heap.end(), std::greater<>());
+}
+
+void FlowField::compute(const float* costs, int costsStride, float maxDist) {
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+    auto [d, offset] = heap.back();
+    heap.pop_back();
+    // this cell was reached again with a shorter distance after it was pushed
+    if (d > dist[offset]) continue;
+    // local coordinates in the field rectangle
+    int x = offset % width;
+    int y = offset / width;
+    for (int i = 0; i < 8; i++) {
+      int nx = x + DIRX[i], ny = y + DIRY[i];
+      if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+      int noffset = nx + ny * width;
+      float cost = costs[nx + ny * costsStride];
+      if (cost <= 0.0f) continue;
+      // the step goes from the neighbour toward the source
+      float nd = d + (DIRX[i] != 0 && DIRY[i] != 0 ? cost * DIAGONAL_COST : cost);
+      if (nd >= dist[noffset] || nd > maxDist) continue;
+      dist[noffset] = nd;
+      heap.push_back(std::make_pair(nd, noffset));
+      std::push_heap(heap.begin(), heap.end(), std::greater<>());
+    }
+  }
+}
+}  // namespace util
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <float.h>
+
+#include <utility>
+#include <vector>
+
+namespace util {
+// dijkstra distance map over a grid of step costs.
+// a cost of 0 means the cell is blocked
+class FlowField {
+ public:
+  static constexpr float UNREACHED = FLT_MAX;
+  // reset the field over a width x height rectangle starting at minx,miny. all cells are unreached
+  void begin(int minx, int miny, int width, int height);
+  void begin(int width, int height) { begin(0, 0, width, height); }
+  void addSource(int x, int y, float dist = 0.0f);
+  // propagate the sources distances. costs[(x - minx) + (y - miny) * costsStride] is the cost of walking out of x,y.
+  // cells farther than maxDist stay unreached
+  void compute(const float* costs, int costsStride, float maxDist = UNREACHED);
+  inline int getWidth() const { return width; }
+  inline int getHeight() const { return height; }
+  inline bool isInside(int x, int y) const {
+    return x >= minx && y >= miny && x < minx + width && y < miny + height;
+  }
+  inline float getDistance(int x, int y) const { return dist[(x - minx) + (y - miny) * width]; }
+  inline bool isReached(int x, int y) const { return getDistance(x, y) != UNREACHED; }
+  // neighbour of x,y with the smallest distance, lower than the distance of x,y, and accepted by canWalk(x, y).
+  // returns false if there is no such neighbour
+  template <class CanWalk>
+  bool getNextStep(int x, int y, int* nx, int* ny, CanWalk canWalk) const {
+    float best = getDistance(x, y);
+    bool found = false;
+    for (int i = 0; i < 8; i++) {
+      int cx = x + DIRX[i], cy = y + DIRY[i];
+      if (!isInside(cx, cy)) continue;
+      float d = getDistance(cx, cy);
+      if (d >= best || !canWalk(cx, cy)) continue;
+      best = d;
+      *nx = cx;
+      *ny = cy;
+      found = true;
+    }
+    return found;
+  }
+
+ protected:
+  static constexpr int DIRX[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+  static constexpr int DIRY[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+  int minx = 0, miny = 0, width = 0, height = 0;
+  std::vector<float> dist;
+  std::vector<std::pair<float, int>> heap;  // open cells, min heap on the distance
+};
+}  // namespace util
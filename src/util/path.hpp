@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <utility>
+#include <vector>
+
+namespace util {
+// list of cells walked from an origin to a destination. the origin is not included
+class Path {
+ public:
+  inline void clear() {
+    steps.clear();
+    next = 0;
+  }
+  inline bool isEmpty() const { return next >= (int)steps.size(); }
+  inline int size() const { return (int)steps.size() - next; }
+  // append a step after the current destination
+  inline void push(int x, int y) { steps.push_back(std::make_pair(x, y)); }
+  // index 0 is the next step
+  inline void get(int index, int* x, int* y) const {
+    *x = steps[next + index].first;
+    *y = steps[next + index].second;
+  }
+  inline void skip(int count) { next += count; }
+  // pop the next step. returns false if the path is empty
+  inline bool walk(int* x, int* y) {
+    if (isEmpty()) return false;
+    get(0, x, y);
+    next++;
+    return true;
+  }
+  // returns false if no path was ever set
+  inline bool getDestination(int* x, int* y) const {
+    if (steps.empty()) return false;
+    *x = steps.back().first;
+    *y = steps.back().second;
+    return true;
+  }
+
+ protected:
+  std::vector<std::pair<int, int>> steps;
+  int next = 0;  // index of the next step
+};
+}  // namespace util
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/profiler.hpp"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace util {
+std::atomic<uint32_t> Profiler::frame{0};
+
+// written by the owner thread only. the dumps read it while it records, hence the relaxed atomics
+struct ProfilerSlot {
+  std::atomic<const char*> name{nullptr};
+  std::atomic<uint32_t> frame{0};
+  std::atomic<uint32_t> depth{0};
+  std::atomic<int64_t> start{0};
+  std::atomic<int64_t> duration{0};
+
+  inline Profiler::Event load() const {
+    return Profiler::Event{
+        name.load(std::memory_order_relaxed),
+        frame.load(std::memory_order_relaxed),
+        depth.load(std::memory_order_relaxed),
+        start.load(std::memory_order_relaxed),
+        duration.load(std::memory_order_relaxed)};
+  }
+};
+
+struct ProfilerRing {
+  ProfilerSlot slots[Profiler::RING_SIZE];
+  std::atomic<uint32_t> count{0};  // number of events ever recorded. newest is at (count-1) % RING_SIZE
+  uint32_t depth = 0;  // current scope nesting level. owner thread only
+  int threadId = 0;
+};
+
+// rings are never deleted so that events of finished threads can still be dumped.
+// the mutex only protects the list of rings, not their content
+static std::mutex ringsMutex;
+static std::vector<ProfilerRing*> rings;
+static const auto startTime = std::chrono::steady_clock::now();
+
+static ProfilerRing* getRing() {
+  thread_local ProfilerRing* ring = nullptr;
+  if (!ring) {
+    ring = new ProfilerRing();
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    ring->threadId = (int)rings.size();
+    rings.push_back(ring);
+  }
+  return ring;
+}
+
+void Profiler::newFrame() { frame++; }
+
+int64_t Profiler::now() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+uint32_t Profiler::enterScope() { return getRing()->depth++; }
+
+void Profiler::exitScope() { getRing()->depth--; }
+
+void Profiler::record(const char* name, int64_t start, int64_t duration, uint32_t depth) {
+  ProfilerRing* ring = getRing();
+  uint32_t count = ring->count.load(std::memory_order_relaxed);
+  ProfilerSlot& slot = ring->slots[count % RING_SIZE];
+  // a dump that sees the new slot content must also see the count telling that the old event is gone
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.frame.store(frame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  slot.depth.store(depth, std::memory_order_relaxed);
+  slot.start.store(start, std::memory_order_relaxed);
+  slot.duration.store(duration, std::memory_order_relaxed);
+  ring->count.store(count + 1, std::memory_order_release);
+}
+
+void Profiler::renderOverlay(TCODConsole* con, int x, int y) {
+  static const int MAX_LINES = 24;
+  struct Line {
+    const char* name;
+    uint32_t depth;
+    int64_t duration;
+  } lines[MAX_LINES];
+  int nbLines = 0;
+  // our own ring. nobody else writes in it
+  ProfilerRing* ring = getRing();
+  uint32_t lastFrame = frame.load() - 1;
+  uint32_t count = ring->count.load(std::memory_order_relaxed);
+  uint32_t first = count > (uint32_t)RING_SIZE ? count - RING_SIZE : 0;
+  // events are recorded when a scope ends. walk backward to the start of the last complete frame
+  uint32_t i = count;
+  while (i > first && ring->slots[(i - 1) % RING_SIZE].frame.load(std::memory_order_relaxed) >= lastFrame) i--;
+  for (; i < count; i++) {
+    const Event ev = ring->slots[i % RING_SIZE].load();
+    if (ev.frame != lastFrame) break;
+    int l = 0;
+    while (l < nbLines && lines[l].name != ev.name) l++;
+    if (l == nbLines) {
+      if (nbLines == MAX_LINES) continue;
+      lines[l].name = ev.name;
+      lines[l].depth = ev.depth;
+      lines[l].duration = 0;
+      nbLines++;
+    }
+    lines[l].duration += ev.duration;
+  }
+  con->setDefaultForeground(TCODColor::white);
+  con->setDefaultBackground(TCODColor::black);
+  con->printEx(x, y++, TCOD_BKGND_SET, TCOD_LEFT, "frame %u", lastFrame);
+  // scopes end after their children. show them from outer to inner
+  for (int l = nbLines - 1; l >= 0; l--) {
+    con->printEx(
+        x,
+        y++,
+        TCOD_BKGND_SET,
+        TCOD_LEFT,
+        "%*s%-20s %6.2fms",
+        (int)lines[l].depth,
+        "",
+        lines[l].name,
+        lines[l].duration / 1000.0f);
+  }
+}
+
+// copy of the recorded events of every thread, oldest first. the other threads keep recording meanwhile
+static std::vector<std::pair<int, Profiler::Event>> copyEvents() {
+  static const uint32_t RING_SIZE = (uint32_t)Profiler::RING_SIZE;
+  std::vector<std::pair<int, Profiler::Event>> events;
+  std::lock_guard<std::mutex> ringsLock(ringsMutex);
+  for (ProfilerRing* ring : rings) {
+    uint32_t count = ring->count.load(std::memory_order_acquire);
+    uint32_t first = count > RING_SIZE ? count - RING_SIZE : 0;
+    size_t ringStart = events.size();
+    for (uint32_t i = first; i < count; i++) events.emplace_back(ring->threadId, ring->slots[i % RING_SIZE].load());
+    // drop the oldest events if the owner may have overwritten them while they were copied
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t newCount = ring->count.load(std::memory_order_relaxed);
+    uint32_t firstValid = newCount >= RING_SIZE ? newCount - RING_SIZE + 1 : 0;
+    if (firstValid > first) {
+      size_t nbOverwritten = std::min<size_t>(firstValid - first, count - first);
+      events.erase(events.begin() + ringStart, events.begin() + ringStart + nbOverwritten);
+    }
+  }
+  return events;
+}
+
+bool Profiler::dumpCsv(const char* filename) {
+  FILE* f = fopen(filename, "w");
+  if (!f) return false;
+  fprintf(f, "thread,frame,depth,name,start_us,duration_us\n");
+  for (const auto& threadEvent : copyEvents()) {
+    const Event& ev = threadEvent.second;
+    fprintf(
+        f,
+        "%d,%u,%u,%s,%lld,%lld\n",
+        threadEvent.first,
+        ev.frame,
+        ev.depth,
+        ev.name,
+        (long long)ev.start,
+        (long long)ev.duration);
+  }
+  fclose(f);
+  return true;
+}
+
+// format read by chrome://tracing and perfetto
+bool Profiler::dumpChromeTrace(const char* filename) {
+  FILE* f = fopen(filename, "w");
+  if (!f) return false;
+  fprintf(f, "{\"traceEvents\":[\n");
+  bool firstEvent = true;
+  for (const auto& threadEvent : copyEvents()) {
+    const Event& ev = threadEvent.second;
+    fprintf(
+        f,
+        "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,\"args\":{\"frame\":%u}}",
+        firstEvent ? "" : ",\n",
+        ev.name,
+        threadEvent.first,
+        (long long)ev.start,
+        (long long)ev.duration,
+        ev.frame);
+    firstEvent = false;
+  }
+  fprintf(f, "\n]}\n");
+  fclose(f);
+  return true;
+}
+}  // namespace util
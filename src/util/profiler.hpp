@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2010 Jice
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of Jice may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jice ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jice BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <libtcod.hpp>
+#include <stdint.h>
+
+#include <atomic>
+
+namespace util {
+// lightweight hot path instrumentation.
+// each thread records its scopes in its own ring buffer, without any lock. the dumps merge the rings.
+class Profiler {
+ public:
+  struct Event {
+    const char* name;  // must be a string literal
+    uint32_t frame;
+    uint32_t depth;  // scope nesting level
+    int64_t start;  // microseconds since profiler start
+    int64_t duration;  // microseconds
+  };
+  static const int RING_SIZE = 16384;
+
+  // call once per game loop iteration
+  static void newFrame();
+  static inline uint32_t getFrame() { return frame.load(); }
+  static int64_t now();
+  static void record(const char* name, int64_t start, int64_t duration, uint32_t depth);
+  static uint32_t enterScope();
+  static void exitScope();
+
+  // frame time breakdown of the last complete frame, on the calling thread
+  static void renderOverlay(TCODConsole* con, int x, int y);
+  // dump every recorded event of every thread
+  static bool dumpCsv(const char* filename);
+  static bool dumpChromeTrace(const char* filename);
+
+ protected:
+  static std::atomic<uint32_t> frame;
+};
+
+class ProfileScope {
+ public:
+  ProfileScope(const char* name) : name(name), start(Profiler::now()), depth(Profiler::enterScope()) {}
+  ~ProfileScope() {
+    Profiler::exitScope();
+    Profiler::record(name, start, Profiler::now() - start, depth);
+  }
+
+ protected:
+  const char* name;
+  int64_t start;
+  uint32_t depth;
+};
+}  // namespace util
+
+#ifdef NO_PROFILER
+#define PROFILE(name)
+#else
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE(name) util::ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#endif
@@ -172,6 +172,7 @@ void RippleManager::startRipple(int dungeonx, int dungeony, float height) {
 }
 
 bool RippleManager::updateRipples(float elapsed) {
+  PROFILE("updateRipples");
   // compute visible part of the dungeon
   base::Rect visibleZone;
   visibleZone.x_ = gameEngine->xOffset;
@@ -287,7 +288,7 @@ bool RippleManager::updateRipples(float elapsed) {
   return updated;
 }
 
-void RippleManager::renderRipples(TCODImage& ground) {
+void RippleManager::renderRipples(TCODImage& ground, util::DirtyRects* dirty) {
   if (zones.size() == 0) init();
   // compute visible part of the dungeon
   base::Rect visibleZone;
@@ -314,6 +315,9 @@ void RippleManager::renderRipples(TCODImage& ground) {
       int maxy = miny + z.h_ - 1;
       int dungeon2groundx = (int)(zone->rect.x_ - visibleZone.x_) * 2;
       int dungeon2groundy = (int)(zone->rect.y_ - visibleZone.y_) * 2;
+      if (dirty) {
+        dirty->add(dungeon2groundx + minx * 2, dungeon2groundy + miny * 2, (maxx - minx) * 2, (maxy - miny) * 2);
+      }
       for (int zx2 = minx * 2; zx2 < maxx * 2; zx2++) {
         int dungeonx2 = (int)(zx2 + zone->rect.x_ * 2);
         int groundx = dungeon2groundx + zx2;
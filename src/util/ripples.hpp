@@ -27,6 +27,7 @@
 #include <libtcod.hpp>
 
 #include "base/entity.hpp"
+#include "util/dirtyrects.hpp"
 #include "util/ripples.hpp"
 
 namespace map {
@@ -52,7 +53,8 @@ class RippleManager {
   RippleManager(map::Dungeon* dungeon);
   void startRipple(int dungeonx, int dungeony, float height = 0.0f);
   bool updateRipples(float elapsed);
-  void renderRipples(TCODImage& ground);
+  // the rendered areas are added to dirty if not NULL
+  void renderRipples(TCODImage& ground, util::DirtyRects* dirty = NULL);
 
  protected:
   map::Dungeon* dungeon = nullptr;
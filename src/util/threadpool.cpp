@@ -27,44 +27,14 @@
 
 #include <stdio.h>
 
+#include <chrono>
+#include <utility>
+
 #include "main.hpp"
 
 namespace util {
-static TCOD_semaphore_t sem = NULL;
-static TCOD_mutex_t todoMutex = NULL;
-static TCOD_mutex_t finishedMutex = NULL;
-static TCODList<ThreadData*> todoList;
-static TCODList<ThreadData*> finished;
-static int jobId = 0;
-ThreadPool* threadPool = nullptr;
-
-int thread_pool_func(void* dat) {
-  // wait for something to do
-  do {
-    TCODSystem::lockSemaphore(sem);
-    // do some job
-    if (todoList.size() > 0) {
-      // get some job from todo list
-      TCODSystem::mutexIn(todoMutex);
-      ThreadData* data = NULL;
-      if (todoList.size() > 0) {
-        data = todoList.get(0);
-        todoList.remove(data);
-      }
-      TCODSystem::mutexOut(todoMutex);
-      if (data && data->job != NULL) {
-        // do the job
-        data->jobResult = data->job(data->jobData);
-        TCODSystem::unlockSemaphore(data->sem);
-        // and put the result in finished list
-        TCODSystem::mutexIn(finishedMutex);
-        finished.push(data);
-        TCODSystem::mutexOut(finishedMutex);
-      }
-    }
-  } while (true);
-  return 0;
-}
+// index of the current thread's deque. -1 for threads not belonging to the pool
+static thread_local int workerIndex = -1;
 
 ThreadPool::ThreadPool() {
   static bool multithread = config.getBoolProperty("config.multithread");
@@ -83,71 +53,222 @@ ThreadPool::ThreadPool() {
       printf("Background threads pool size : %d\n", nbThreads);
     }
   }
-  sem = TCODSystem::newSemaphore(0);
-  todoMutex = TCODSystem::newMutex();
-  finishedMutex = TCODSystem::newMutex();
-  // start all the threads and put them in idle state
+  // create all the deques before starting the threads so that they can steal from each other
+  for (int i = 0; i < nbThreads; i++) {
+    workers.push_back(std::make_unique<Worker>());
+  }
   for (int i = 0; i < nbThreads; i++) {
-    threads.push(TCODSystem::newThread(thread_pool_func, NULL));
+    threads.emplace_back(&ThreadPool::workerLoop, this, i);
   }
 }
 
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    stopping = true;
+  }
+  wakeUp.notify_all();
+  for (std::thread& thread : threads) thread.join();
+}
+
+bool ThreadPool::isWorkerThread() { return workerIndex >= 0; }
+
 bool ThreadPool::isMultiThreadEnabled() {
   static bool multithread = config.getBoolProperty("config.multithread");
   return multithread;
 }
 
-int ThreadPool::addJob(thread_job_t job, void* jobData) {
-  ThreadData* data = new ThreadData();
-  data->job = job;
-  data->jobData = jobData;
-  data->sem = TCODSystem::newSemaphore(0);
-  TCODSystem::mutexIn(todoMutex);
-  data->id = jobId++;
-  todoList.push(data);
-  TCODSystem::mutexOut(todoMutex);
-  TCODSystem::unlockSemaphore(sem);
-  return data->id;
+void ThreadPool::push(Task task) {
+  // a worker pushes on its own deque. other threads spread the tasks over all the deques
+  int index = workerIndex >= 0 ? workerIndex : (int)(nextWorker++ % workers.size());
+  Worker& worker = *workers[index];
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    nbPending++;
+  }
+  wakeUp.notify_one();
+}
+
+void ThreadPool::pushLowPriority(Task task) {
+  {
+    std::lock_guard<std::mutex> lock(lowPriorityMutex);
+    lowPriorityTasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    nbPending++;
+  }
+  wakeUp.notify_one();
 }
 
-bool ThreadPool::isFinished(int jobId) {
-  TCODSystem::mutexIn(finishedMutex);
-  for (ThreadData** it = finished.begin(); it != finished.end(); it++) {
-    if ((*it)->id == jobId) {
-      finished.remove(it);
-      TCODSystem::mutexOut(finishedMutex);
-      TCODSystem::deleteSemaphore((*it)->sem);
-      delete (*it);
+bool ThreadPool::popTask(Task* task, bool lowPriority) {
+  int nbWorkers = (int)workers.size();
+  if (nbWorkers == 0 || nbPending == 0) return false;
+  // newest task from our own deque first, it's probably still in the cache
+  if (workerIndex >= 0) {
+    Worker& worker = *workers[workerIndex];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (!worker.tasks.empty()) {
+      *task = std::move(worker.tasks.back());
+      worker.tasks.pop_back();
+      nbPending--;
+      return true;
+    }
+  }
+  // else steal the oldest task of someone else
+  int start = workerIndex >= 0 ? workerIndex + 1 : 0;
+  for (int i = 0; i < nbWorkers; i++) {
+    Worker& victim = *workers[(start + i) % nbWorkers];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      *task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      nbPending--;
+      return true;
+    }
+  }
+  if (lowPriority) {
+    std::lock_guard<std::mutex> lock(lowPriorityMutex);
+    if (!lowPriorityTasks.empty()) {
+      *task = std::move(lowPriorityTasks.front());
+      lowPriorityTasks.pop_front();
+      nbPending--;
       return true;
     }
   }
-  TCODSystem::mutexOut(finishedMutex);
   return false;
 }
 
+bool ThreadPool::runPendingTask(bool lowPriority) {
+  Task task;
+  if (!popTask(&task, lowPriority)) return false;
+  task();
+  return true;
+}
+
+void ThreadPool::workerLoop(int index) {
+  workerIndex = index;
+  while (!stopping) {
+    if (runPendingTask(true)) continue;
+    // nothing to do. sleep until a task is pushed
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    wakeUp.wait(lock, [this]() { return stopping || nbPending > 0; });
+  }
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const std::function<void(int from, int to)>& func) {
+  if (end <= begin) return;
+  int nbWorkers = (int)workers.size();
+  // a few chunks per thread so that the fast threads can steal from the slow ones
+  int chunkSize = std::max(std::max(grain, 1), (end - begin) / ((nbWorkers + 1) * 4));
+  if (nbWorkers == 0 || end - begin <= chunkSize) {
+    func(begin, end);
+    return;
+  }
+  TaskGroup group(this);
+  // keep the first chunk for the calling thread
+  for (int from = begin + chunkSize; from < end; from += chunkSize) {
+    int to = std::min(from + chunkSize, end);
+    group.run([&func, from, to]() { func(from, to); });
+  }
+  func(begin, std::min(begin + chunkSize, end));
+  group.wait();
+}
+
+int ThreadPool::addJob(thread_job_t job, void* data) {
+  auto task = std::make_shared<std::packaged_task<int()>>([job, data]() { return job(data); });
+  std::lock_guard<std::mutex> lock(jobsMutex);
+  int id = jobId++;
+  jobs[id] = task->get_future();
+  if (workers.empty()) {
+    // no thread. the job will be done by waitUntilFinished
+    deferredJobs[id] = task;
+  } else {
+    push([task]() { (*task)(); });
+  }
+  return id;
+}
+
+bool ThreadPool::isFinished(int jobId) {
+  std::lock_guard<std::mutex> lock(jobsMutex);
+  auto it = jobs.find(jobId);
+  if (it == jobs.end()) return true;
+  if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+  jobs.erase(it);
+  return true;
+}
+
 void ThreadPool::waitUntilFinished(int jobId) {
-  if (isFinished(jobId)) return;  // job already finished
-  TCODSystem::mutexIn(todoMutex);
-  for (ThreadData** it = todoList.begin(); it != todoList.end(); it++) {
-    if ((*it)->id == jobId) {
-      // wait for job to finish
-      TCODSystem::mutexOut(todoMutex);
-      if (threads.size() == 0) {
-        // no thread ! do it yourself, pal!
-        (*it)->job((*it)->jobData);
-        TCODSystem::mutexIn(todoMutex);
-        todoList.remove(it);
-        TCODSystem::mutexOut(todoMutex);
-        TCODSystem::deleteSemaphore((*it)->sem);
-        delete (*it);
-      } else {
-        // wait for the thread to finished the job
-        TCODSystem::lockSemaphore((*it)->sem);
-        isFinished(jobId);  // todo release resources
+  std::shared_ptr<std::packaged_task<int()>> deferred;
+  std::future<int> result;
+  {
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    auto it = jobs.find(jobId);
+    if (it == jobs.end()) return;  // job already finished
+    result = std::move(it->second);
+    jobs.erase(it);
+    auto dit = deferredJobs.find(jobId);
+    if (dit != deferredJobs.end()) {
+      deferred = dit->second;
+      deferredJobs.erase(dit);
+    }
+  }
+  if (deferred) {
+    // no thread ! do it yourself, pal!
+    (*deferred)();
+    return;
+  }
+  // help the workers while there are pending tasks, then sleep until a worker has done the job
+  while (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready && runPendingTask()) {
+  }
+  result.wait();
+}
+
+void TaskGroup::run(ThreadPool::Task task) {
+  if (pool->workers.empty()) {
+    task();
+    return;
+  }
+  nbRunning++;
+  pool->push([this, task = std::move(task)]() {
+    // the task is over even if it throws. wait() must not hang
+    struct Done {
+      TaskGroup* group;
+      ~Done() {
+        std::lock_guard<std::mutex> lock(group->mutex);
+        group->nbRunning--;
+        group->finished.notify_all();
       }
-      return;
+    } done{this};
+    try {
+      task();
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error) error = std::current_exception();
     }
+  });
+}
+
+void TaskGroup::join() {
+  // help while there are pending tasks, then sleep until the tasks of the other threads are done
+  while (nbRunning > 0 && pool->runPendingTask()) {
+  }
+  // always take the lock. the last task may still be notifying
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [this]() { return nbRunning == 0; });
+}
+
+void TaskGroup::wait() {
+  join();
+  std::exception_ptr taskError;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::swap(taskError, error);
   }
-  TCODSystem::mutexOut(todoMutex);
+  if (taskError) std::rethrow_exception(taskError);
 }
 }  // namespace util
@@ -24,29 +24,123 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #pragma once
-#include <libtcod.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace util {
 typedef int (*thread_job_t)(void* dat);
 
-struct ThreadData {
-  int id;
-  void* jobData = nullptr;
-  TCOD_semaphore_t sem;
-  thread_job_t job;
-  int jobResult;
-};
-
+// work stealing scheduler.
+// each worker has its own task deque. it pops its newest task first and steals
+// the oldest task of the other workers when it has nothing to do.
+// low priority tasks have their own queue, only read by the workers once the deques are empty.
+// when multithreading is disabled in config.txt, everything runs on the calling thread.
 class ThreadPool {
  public:
+  typedef std::function<void()> Task;
+
   ThreadPool();
+  ~ThreadPool();
+
+  // run a task in the background. the future holds its result
+  template <typename F>
+  auto submit(F&& func) -> std::future<decltype(func())> {
+    typedef decltype(func()) R;
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+    std::future<R> ret = task->get_future();
+    if (workers.empty()) {
+      (*task)();
+    } else {
+      push([task]() { (*task)(); });
+    }
+    return ret;
+  }
+  // same as submit, for long background work (path searches...). the threads waiting for a task group
+  // don't help with these tasks, so they never delay a frame
+  template <typename F>
+  auto submitLowPriority(F&& func) -> std::future<decltype(func())> {
+    typedef decltype(func()) R;
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+    std::future<R> ret = task->get_future();
+    if (workers.empty()) {
+      (*task)();
+    } else {
+      pushLowPriority([task]() { (*task)(); });
+    }
+    return ret;
+  }
+  // call func(from,to) on sub ranges of [begin,end) of at least grain indexes.
+  // returns when the whole range has been processed. the calling thread takes part.
+  void parallelFor(int begin, int end, int grain, const std::function<void(int from, int to)>& func);
+  inline int getNbWorkers() const { return (int)workers.size(); }
+  // true when called from one of the pool's threads
+  static bool isWorkerThread();
+  bool isMultiThreadEnabled();
+
+  // old style jobs, identified by an id
   int addJob(thread_job_t job, void* data);
   bool isFinished(int jobId);
-  bool isMultiThreadEnabled();
   void waitUntilFinished(int jobId);
 
  protected:
-  TCODList<TCOD_thread_t> threads;
+  friend class TaskGroup;
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+  std::vector<std::thread> threads;
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::mutex lowPriorityMutex;
+  std::deque<Task> lowPriorityTasks;
+  std::mutex sleepMutex;
+  std::condition_variable wakeUp;
+  std::atomic<int> nbPending{0};
+  std::atomic<bool> stopping{false};
+  std::atomic<unsigned int> nextWorker{0};
   int nbCores;
+
+  std::mutex jobsMutex;
+  int jobId = 0;
+  std::map<int, std::future<int>> jobs;
+  // jobs waiting for waitUntilFinished when there is no worker thread
+  std::map<int, std::shared_ptr<std::packaged_task<int()>>> deferredJobs;
+
+  void push(Task task);
+  void pushLowPriority(Task task);
+  // run one pending task, if any. used by the workers and by the threads waiting for a task group.
+  // only the workers take the low priority tasks
+  bool runPendingTask(bool lowPriority = false);
+  bool popTask(Task* task, bool lowPriority);
+  void workerLoop(int index);
+};
+
+// a set of tasks that can be waited for
+class TaskGroup {
+ public:
+  TaskGroup(ThreadPool* pool) : pool(pool) {}
+  // waits for the tasks still running. their exceptions are lost if wait was not called
+  ~TaskGroup() { join(); }
+  void run(ThreadPool::Task task);
+  // wait for all the tasks of the group. the calling thread runs pending tasks meanwhile.
+  // rethrows the first exception thrown by a task
+  void wait();
+
+ protected:
+  ThreadPool* pool = nullptr;
+  std::atomic<int> nbRunning{0};  // only decremented with mutex held
+  std::mutex mutex;
+  std::condition_variable finished;
+  std::exception_ptr error;
+
+  void join();
 };
 }  // namespace util